@@ -1,11 +1,26 @@
 #include "cache_simulator.h"
 
-Bus::Bus() : invalidations(0), data_traffic_bytes(0) {}
+Bus::Bus(int socket_id) : 
+    invalidations(0), 
+    data_traffic_bytes(0), 
+    debug(false),
+    socket_id(socket_id),
+    interconnect(nullptr),
+    current_cycle(0) {}
 
 void Bus::addCache(Cache* cache) {
     caches.push_back(cache);
 }
 
+Cache* Bus::findCache(int core_id) {
+    for (Cache* cache : caches) {
+        if (cache->getCoreId() == core_id) {
+            return cache;
+        }
+    }
+    return nullptr;
+}
+
 void Bus::addDataTraffic(int bytes) {
     // Debug print to verify this is being called
     //std::cout << "DEBUG: Adding " << bytes << " bytes to bus traffic" << std::endl;
@@ -15,8 +30,10 @@ void Bus::addDataTraffic(int bytes) {
 // In bus.cpp
 void Bus::processRead(int requester_id, uint32_t addr, int& cycles_taken) {
     // Debug the address being requested
-    std::cout << "DEBUG: Core " << requester_id << " requesting address 0x" 
-              << std::hex << addr << std::dec << std::endl;
+    if (debug) {
+        std::cout << "DEBUG: Core " << requester_id << " requesting address 0x" 
+                  << std::hex << addr << std::dec << std::endl;
+    }
     
     bool found_in_cache = false;
     int max_cycles = 0;
@@ -27,31 +44,47 @@ void Bus::processRead(int requester_id, uint32_t addr, int& cycles_taken) {
             int data_transfer_cycles = 0;
             
             // Add debug before busRead call
-            std::cout << "DEBUG: Checking if Core " << cache->getCoreId() 
-                      << " has address 0x" << std::hex << addr << std::dec << std::endl;
+            if (debug) {
+                std::cout << "DEBUG: Checking if Core " << cache->getCoreId() 
+                          << " has address 0x" << std::hex << addr << std::dec << std::endl;
+            }
             
-            cache->busRead(addr, caches[requester_id], data_transfer_cycles);
+            cache->busRead(addr, findCache(requester_id), data_transfer_cycles);
             
             // Add debug after busRead call
-            std::cout << "DEBUG: Core " << cache->getCoreId() 
-                      << " data_transfer_cycles: " << data_transfer_cycles << std::endl;
+            if (debug) {
+                std::cout << "DEBUG: Core " << cache->getCoreId() 
+                          << " data_transfer_cycles: " << data_transfer_cycles << std::endl;
+            }
             
             if (data_transfer_cycles > 0) {
                 found_in_cache = true;
                 max_cycles = std::max(max_cycles, data_transfer_cycles);
                 
                 // Debug what was found
-                std::cout << "DEBUG: Found data in Core " << cache->getCoreId() 
-                          << ", transfer will take " << data_transfer_cycles << " cycles" << std::endl;
+                if (debug) {
+                    std::cout << "DEBUG: Found data in Core " << cache->getCoreId() 
+                              << ", transfer will take " << data_transfer_cycles << " cycles" << std::endl;
+                }
             }
         }
     }
     
     // This is critical - make sure to set cycles correctly
-    cycles_taken = found_in_cache ? max_cycles : 100;  // Memory fetch if not found
+    if (!interconnect) {
+        cycles_taken = found_in_cache ? max_cycles : 100;  // Memory fetch if not found
+    } else if (found_in_cache) {
+        interconnect->recordLocalTransfer(socket_id);
+        cycles_taken = max_cycles;
+    } else {
+        // Remote caches or the block's home memory
+        cycles_taken = interconnect->fetchBlock(socket_id, findCache(requester_id), addr);
+    }
     
-    std::cout << "DEBUG: Final cycles_taken: " << cycles_taken 
-              << " (found_in_cache: " << found_in_cache << ")" << std::endl;
+    if (debug) {
+        std::cout << "DEBUG: Final cycles_taken: " << cycles_taken 
+                  << " (found_in_cache: " << found_in_cache << ")" << std::endl;
+    }
 }
 
 // In bus.cpp
@@ -64,7 +97,7 @@ void Bus::processWrite(int requester_id, uint32_t addr, int& cycles_taken) {
     for (Cache* cache : caches) {
         if (cache->getCoreId() != requester_id) {
             int data_transfer_cycles = 0;
-            cache->busRead(addr, caches[requester_id], data_transfer_cycles);
+            cache->busRead(addr, findCache(requester_id), data_transfer_cycles);
             
             if (data_transfer_cycles > 0) {
                 found_in_cache = true;
@@ -73,20 +106,43 @@ void Bus::processWrite(int requester_id, uint32_t addr, int& cycles_taken) {
         }
     }
     
+    // Not on this socket: fetch from a remote cache or the home memory
+    int remote_cycles = 0;
+    if (interconnect) {
+        if (found_in_cache) {
+            interconnect->recordLocalTransfer(socket_id);
+        } else {
+            remote_cycles = interconnect->fetchBlock(socket_id, findCache(requester_id), addr);
+        }
+    }
+    
     // Then invalidate all copies in other caches
     for (Cache* cache : caches) {
         if (cache->getCoreId() != requester_id) {
-            cache->busWrite(addr, caches[requester_id]);
-            std::cout << "DEBUG: Calling busWrite on Core " << cache->getCoreId() << std::endl;
+            cache->busWrite(addr, findCache(requester_id));
+            if (debug) {
+                std::cout << "DEBUG: Calling busWrite on Core " << cache->getCoreId() << std::endl;
+            }
 
             invalidation_count++;
         }
     }
     invalidations += invalidation_count;  // Update the counter
-    std::cout << "DEBUG: After processWrite, invalidations=" << invalidations << std::endl;
+    if (debug) {
+        std::cout << "DEBUG: After processWrite, invalidations=" << invalidations << std::endl;
+    }
 
     // Set cycles based on where data came from
-    cycles_taken = found_in_cache ? max_cycles : 100;
+    if (!interconnect) {
+        cycles_taken = found_in_cache ? max_cycles : 100;
+    } else if (found_in_cache) {
+        // Remote copies still have to be invalidated over the link
+        cycles_taken = max_cycles + interconnect->invalidateRemote(socket_id, findCache(requester_id), addr, false);
+    } else {
+        // The invalidation overlaps with the remote fetch
+        interconnect->invalidateRemote(socket_id, findCache(requester_id), addr, false);
+        cycles_taken = remote_cycles;
+    }
 }
 
 void Bus::processUpgrade(int requester_id, uint32_t addr, int& cycles_taken) {
@@ -95,7 +151,7 @@ void Bus::processUpgrade(int requester_id, uint32_t addr, int& cycles_taken) {
     for (Cache* cache : caches) {
         if (cache->getCoreId() != requester_id) {
             // Call busUpgrade without expecting a return value
-            cache->busUpgrade(addr);
+            cache->busUpgrade(addr, findCache(requester_id));
             
             // Assume an invalidation happens when we call busUpgrade
             // Again, this is slightly inaccurate but simpler
@@ -107,10 +163,44 @@ void Bus::processUpgrade(int requester_id, uint32_t addr, int& cycles_taken) {
     
     // Upgrade takes 2 cycles for bus transaction
     cycles_taken = 2;
+    if (interconnect) {
+        cycles_taken += interconnect->invalidateRemote(socket_id, findCache(requester_id), addr, true);
+    }
+}
+
+int Bus::processWriteback(uint32_t addr) {
+    // Writeback to memory takes 100 cycles, more if the home node is remote
+    if (interconnect) {
+        return interconnect->writebackBlock(socket_id, addr);
+    }
+    return 100;
+}
+
+int Bus::snoopRead(uint32_t addr, Cache* requester) {
+    int max_cycles = 0;
+    for (Cache* cache : caches) {
+        int data_transfer_cycles = 0;
+        cache->busRead(addr, requester, data_transfer_cycles);
+        max_cycles = std::max(max_cycles, data_transfer_cycles);
+    }
+    return max_cycles;
+}
+
+int Bus::snoopInvalidate(uint32_t addr, Cache* requester, bool upgrade) {
+    int invalidated = 0;
+    for (Cache* cache : caches) {
+        bool hit = upgrade ? cache->busUpgrade(addr, requester) : cache->busWrite(addr, requester);
+        if (hit) {
+            invalidated++;
+        }
+    }
+    return invalidated;
 }
 
 // In Bus::getInvalidations:
 int Bus::getInvalidations() const {
-    std::cout << "DEBUG: getInvalidations called, returning " << invalidations << std::endl;
+    if (debug) {
+        std::cout << "DEBUG: getInvalidations called, returning " << invalidations << std::endl;
+    }
     return invalidations;
 }
@@ -1,50 +1,161 @@
 #include "cache_simulator.h"
 
-Cache::Cache(int core_id, int s, int E, int b, Bus* bus) : 
+Cache::Cache(int core_id, int s, int E, int b, Bus* bus, std::mt19937& rng,
+             IndexFunction index_fn, ReplacementPolicy policy) : 
     core_id(core_id),
     assoc(E),
     s_bits(s), 
     sets(1 << s),
     block_size(1 << b),
     b_bits(b),
+    index_fn(index_fn),
+    prime_sets(1),
+    policy(policy),
+    rng(&rng),
     bus(bus),
     read_count(0),
     write_count(0),
     read_misses(0),
     write_misses(0),
     evictions(0),
-    writebacks(0) {
+    writebacks(0),
+    set_accesses(1 << s, 0),
+    set_misses(1 << s, 0),
+    set_evictions(1 << s, 0),
+    bulk_active(false) {
     
     // Initialize cache sets
     cache_sets.reserve(sets);
     for (int i = 0; i < sets; i++) {
         cache_sets.emplace_back(assoc, block_size);
     }
+    
+    // Largest prime not above the set count (sets beyond it stay unused)
+    for (int p = sets; p >= 2; p--) {
+        bool is_prime = true;
+        for (int d = 2; d * d <= p; d++) {
+            if (p % d == 0) {
+                is_prime = false;
+                break;
+            }
+        }
+        if (is_prime) {
+            prime_sets = p;
+            break;
+        }
+    }
+}
+
+// XOR together successive s-bit chunks of value
+uint32_t Cache::foldTag(uint32_t value) const {
+    uint32_t folded = 0;
+    if (s_bits == 0) return 0;
+    while (value) {
+        folded ^= value & (sets - 1);
+        value >>= s_bits;
+    }
+    return folded;
+}
+
+int Cache::setIndex(uint32_t addr, int way) const {
+    uint32_t block_addr = addr >> b_bits;
+    uint32_t low_bits = block_addr & (sets - 1);
+    uint32_t tag_bits = addr >> (b_bits + s_bits);
+    
+    switch (index_fn) {
+        case IndexFunction::XOR_FOLD:
+            return low_bits ^ foldTag(tag_bits);
+        case IndexFunction::SKEWED:
+            // A different odd multiplier per way scatters the tag bits
+            // differently, way 0 matches XOR_FOLD
+            return low_bits ^ foldTag(tag_bits * (2 * way + 1));
+        case IndexFunction::PRIME:
+            return block_addr % prime_sets;
+        case IndexFunction::MODULO:
+        default:
+            return low_bits;
+    }
 }
 
 void Cache::extractAddressFields(uint32_t addr, uint32_t& tag, int& set_idx, uint32_t& block_offset) {
     block_offset = addr & ((1 << b_bits) - 1);
-    set_idx = (addr >> b_bits) & ((1 << s_bits) - 1);
-    tag = addr >> (b_bits + s_bits);
+    set_idx = setIndex(addr, 0);
+    
+    // The XOR-based indexes only mix tag bits into the low bits, so the
+    // usual tag still identifies the block within its set
+    if (index_fn == IndexFunction::PRIME) {
+        tag = (addr >> b_bits) / prime_sets;
+    } else {
+        tag = addr >> (b_bits + s_bits);
+    }
 }
 
 CacheLine* Cache::findLine(uint32_t addr, uint32_t& tag, int& set_idx) {
     uint32_t block_offset;
     extractAddressFields(addr, tag, set_idx, block_offset);
+    
+    if (index_fn == IndexFunction::SKEWED) {
+        // Each way is indexed by its own hash of the address
+        for (int way = 0; way < assoc; way++) {
+            int way_set = setIndex(addr, way);
+            CacheLine* line = cache_sets[way_set].getLine(way);
+            if (line->valid && line->tag == tag) {
+                set_idx = way_set;
+                return line;
+            }
+        }
+        return nullptr;
+    }
     return cache_sets[set_idx].findLine(tag);
 }
 
-bool Cache::read(uint32_t addr, int cycle, int& cycles_taken) {
+CacheLine* Cache::findReplacementLine(uint32_t addr, int& set_idx, int& eviction_result) {
+    if (index_fn != IndexFunction::SKEWED) {
+        return cache_sets[set_idx].findReplacementLine(eviction_result, policy, *rng);
+    }
+    
+    // Skewed: one candidate per way, prefer invalid lines, then the policy's
+    // choice with equally old candidates picked at random
+    CacheLine* victim = nullptr;
+    int ties = 0;
+    for (int way = 0; way < assoc; way++) {
+        int way_set = setIndex(addr, way);
+        CacheLine* line = cache_sets[way_set].getLine(way);
+        if (!line->valid) {
+            set_idx = way_set;
+            eviction_result = 0;  // No eviction needed
+            return line;
+        }
+        
+        bool take;
+        if (policy == ReplacementPolicy::RANDOM) {
+            take = CacheSet::keepTie(++ties, *rng);
+        } else if (!victim || line->last_access < victim->last_access) {
+            take = true;
+            ties = 1;
+        } else {
+            take = line->last_access == victim->last_access && CacheSet::keepTie(++ties, *rng);
+        }
+        if (take) {
+            victim = line;
+            set_idx = way_set;
+        }
+    }
+    
+    eviction_result = (victim->dirty) ? 2 : 1;  // 2 = dirty eviction, 1 = clean eviction
+    return victim;
+}
+
+bool Cache::read(uint32_t addr, long long cycle, int& cycles_taken) {
     uint32_t tag;
     int set_idx;
-    uint32_t block_offset;
-    extractAddressFields(addr, tag, set_idx, block_offset);
     
     read_count++;
-    CacheLine* line = cache_sets[set_idx].findLine(tag);
+    CacheLine* line = findLine(addr, tag, set_idx);
     
     if (line && line->valid && line->state != MESIState::INVALID) {
         // Cache hit
+        set_accesses[set_idx]++;
         cache_sets[set_idx].updateLRU(line, cycle);
         cycles_taken = 1;  // L1 hit takes 1 cycle
         return true;
@@ -58,14 +169,17 @@ bool Cache::read(uint32_t addr, int cycle, int& cycles_taken) {
         
         // Find line to replace
         int eviction_result = 0;
-        CacheLine* replacement = cache_sets[set_idx].findReplacementLine(eviction_result);
+        CacheLine* replacement = findReplacementLine(addr, set_idx, eviction_result);
+        set_accesses[set_idx]++;
+        set_misses[set_idx]++;
         
         // Handle eviction and writeback if necessary
         if (eviction_result > 0) {
             evictions++;
+            set_evictions[set_idx]++;
             if (eviction_result == 2) {  // Dirty eviction
                 writebacks++;
-                cycles_taken = 100;  // Writeback to memory takes 100 cycles
+                cycles_taken = bus->processWriteback(lineAddress(replacement, set_idx));
             } else {
                 cycles_taken = 0;  // Clean eviction, no additional cycles
             }
@@ -87,17 +201,16 @@ bool Cache::read(uint32_t addr, int cycle, int& cycles_taken) {
     }
 }
 
-bool Cache::write(uint32_t addr, int cycle, int& cycles_taken) {
+bool Cache::write(uint32_t addr, long long cycle, int& cycles_taken) {
     uint32_t tag;
     int set_idx;
-    uint32_t block_offset;
-    extractAddressFields(addr, tag, set_idx, block_offset);
     
     write_count++;
-    CacheLine* line = cache_sets[set_idx].findLine(tag);
+    CacheLine* line = findLine(addr, tag, set_idx);
     
     if (line && line->valid && line->state != MESIState::INVALID) {
         // Cache hit, update based on current state
+        set_accesses[set_idx]++;
         cache_sets[set_idx].updateLRU(line, cycle);
         
         if (line->state == MESIState::MODIFIED) {
@@ -128,14 +241,17 @@ bool Cache::write(uint32_t addr, int cycle, int& cycles_taken) {
         
         // Find line to replace
         int eviction_result = 0;
-        CacheLine* replacement = cache_sets[set_idx].findReplacementLine(eviction_result);
+        CacheLine* replacement = findReplacementLine(addr, set_idx, eviction_result);
+        set_accesses[set_idx]++;
+        set_misses[set_idx]++;
         
         // Handle eviction and writeback if necessary
         if (eviction_result > 0) {
             evictions++;
+            set_evictions[set_idx]++;
             if (eviction_result == 2) {  // Dirty eviction
                 writebacks++;
-                cycles_taken = 100;  // Writeback to memory takes 100 cycles
+                cycles_taken = bus->processWriteback(lineAddress(replacement, set_idx));
             } else {
                 cycles_taken = 0;  // Clean eviction, no additional cycles
             }
@@ -162,21 +278,22 @@ bool Cache::write(uint32_t addr, int cycle, int& cycles_taken) {
 void Cache::busRead(uint32_t addr, Cache* requester, int& data_transfer_cycles) {
     uint32_t tag;
     int set_idx;
-    uint32_t block_offset;
-    extractAddressFields(addr, tag, set_idx, block_offset);
-    
-    CacheSet& set = cache_sets[set_idx];
-    CacheLine* line = set.findLine(tag);
+    CacheLine* line = findLine(addr, tag, set_idx);
     
     // Debug what was found
-    std::cout << "DEBUG: Core " << core_id << " busRead check for tag 0x" 
-              << std::hex << tag << " set " << std::dec << set_idx;
+    if (bus->isDebug()) {
+        std::cout << "DEBUG: Core " << core_id << " busRead check for tag 0x" 
+                  << std::hex << tag << " set " << std::dec << set_idx;
+    }
     
     if (line && line->valid && line->state != MESIState::INVALID) {
-        std::cout << " - FOUND in state " << (int)line->state << std::endl;
+        if (bus->isDebug()) {
+            std::cout << " - FOUND in state " << (int)line->state << std::endl;
+        }
         
         if (line->state == MESIState::MODIFIED) {
             // Provide data and update state
+            noteSnoop(line, requester);
             line->state = MESIState::SHARED;
             line->dirty = false;
             data_transfer_cycles = 2 * (block_size / 4);  // 2 cycles per word
@@ -184,6 +301,7 @@ void Cache::busRead(uint32_t addr, Cache* requester, int& data_transfer_cycles)
         } 
         else if (line->state == MESIState::EXCLUSIVE) {
             // Provide data and update state
+            noteSnoop(line, requester);
             line->state = MESIState::SHARED;
             data_transfer_cycles = 2 * (block_size / 4);  // 2 cycles per word
             bus->addDataTraffic(block_size);
@@ -193,12 +311,12 @@ void Cache::busRead(uint32_t addr, Cache* requester, int& data_transfer_cycles)
             data_transfer_cycles = 2 * (block_size / 4);  // 2 cycles per word
             bus->addDataTraffic(block_size);
         }
-    } else {
+    } else if (bus->isDebug()) {
         std::cout << " - NOT FOUND" << std::endl;
     }
 }
 
-void Cache::busWrite(uint32_t addr, Cache* requester) {
+bool Cache::busWrite(uint32_t addr, Cache* requester) {
     uint32_t tag;
     int set_idx;
     CacheLine* line = findLine(addr, tag, set_idx);
@@ -207,21 +325,104 @@ void Cache::busWrite(uint32_t addr, Cache* requester) {
         (line->state == MESIState::SHARED || 
          line->state == MESIState::EXCLUSIVE)) {
         // Invalidate the line
+        noteSnoop(line, requester);
         line->state = MESIState::INVALID;
         bus->incrementInvalidations();
+        return true;
     }
+    return false;
 }
 
-void Cache::busUpgrade(uint32_t addr) {
+bool Cache::busUpgrade(uint32_t addr, Cache* requester) {
     uint32_t tag;
     int set_idx;
     CacheLine* line = findLine(addr, tag, set_idx);
     
     if (line && line->valid && line->state == MESIState::SHARED) {
         // Invalidate the line on upgrade request
+        noteSnoop(line, requester);
         line->state = MESIState::INVALID;
         bus->incrementInvalidations();
+        return true;
+    }
+    return false;
+}
+
+bool Cache::beginBulkHits(uint32_t addr, int reads, int writes, long long cycle, int count) {
+    uint32_t tag;
+    int set_idx;
+    CacheLine* line = findLine(addr, tag, set_idx);
+    
+    // Only runs that hit without touching the bus: reads of any valid
+    // line, or reads and writes of a line already in Modified state
+    if (!line || !line->valid || line->state == MESIState::INVALID) {
+        return false;
+    }
+    if (writes > 0 && line->state != MESIState::MODIFIED) {
+        return false;
+    }
+    
+    bulk.line = line;
+    bulk.set_idx = set_idx;
+    bulk.start_cycle = cycle;
+    bulk.count = count;
+    bulk.saved_last_access = line->last_access;
+    bulk.broken = false;
+    bulk_active = true;
+    
+    // Same effect as count single-cycle hits at cycle, cycle + 1, ...
+    read_count += reads;
+    write_count += writes;
+    set_accesses[set_idx] += count;
+    cache_sets[set_idx].updateLRU(line, cycle + count - 1);
+    return true;
+}
+
+void Cache::noteSnoop(CacheLine* line, Cache* requester) {
+    // Record only the first snoop that changes the line under a bulk run
+    if (bulk_active && !bulk.broken && line == bulk.line) {
+        bulk.broken = true;
+        bulk.break_cycle = bus->getCurrentCycle();
+        bulk.breaker_id = requester ? requester->getCoreId() : -1;
+    }
+}
+
+int Cache::getBulkHitsCompleted() const {
+    // Within a cycle cores run in id order, so a lower id core's hit in
+    // the breaking cycle happened before the snoop
+    long long done = bulk.break_cycle - bulk.start_cycle + (core_id < bulk.breaker_id ? 1 : 0);
+    return (int)std::max(0LL, std::min((long long)bulk.count, done));
+}
+
+void Cache::rollbackBulkHits(int undone_reads, int undone_writes) {
+    int done = getBulkHitsCompleted();
+    read_count -= undone_reads;
+    write_count -= undone_writes;
+    set_accesses[bulk.set_idx] -= undone_reads + undone_writes;
+    bulk.line->last_access = (done > 0) ? bulk.start_cycle + done - 1 : bulk.saved_last_access;
+    bulk_active = false;
+}
+
+uint32_t Cache::lineAddress(const CacheLine* line, int set_idx) {
+    uint32_t tag = line->tag;
+    if (index_fn == IndexFunction::PRIME) {
+        return (tag * prime_sets + set_idx) << b_bits;
+    }
+    
+    // Undo the XOR of the tag bits into the set index
+    uint32_t low_bits = set_idx;
+    if (index_fn == IndexFunction::XOR_FOLD) {
+        low_bits ^= foldTag(tag);
+    } else if (index_fn == IndexFunction::SKEWED) {
+        for (int way = 0; way < assoc; way++) {
+            if (cache_sets[set_idx].getLine(way) == line) {
+                low_bits ^= foldTag(tag * (2 * way + 1));
+                break;
+            }
+        }
     }
+    uint32_t high_bits = (s_bits + b_bits < 32) ? tag << (s_bits + b_bits) : 0;
+    return high_bits | (low_bits << b_bits);
 }
 
 float Cache::getMissRate() const {
@@ -15,7 +15,12 @@ CacheLine* CacheSet::findLine(uint32_t tag) {
     return nullptr;
 }
 
-CacheLine* CacheSet::findReplacementLine(int& eviction_result) {
+bool CacheSet::keepTie(int ties, std::mt19937& rng) {
+    return ties == 1 || std::uniform_int_distribution<int>(0, ties - 1)(rng) == 0;
+}
+
+CacheLine* CacheSet::findReplacementLine(int& eviction_result, ReplacementPolicy policy,
+                                         std::mt19937& rng) {
     // First, check for any invalid lines
     for (int i = 0; i < associativity; i++) {  // Use associativity here
         if (!lines[i]->valid) {
@@ -24,23 +29,28 @@ CacheLine* CacheSet::findReplacementLine(int& eviction_result) {
         }
     }
     
-    // If all valid, find the LRU line
-    int min_access = lines[0]->last_access;
-    CacheLine* lru_line = lines[0].get();
-    
-    for (auto& line : lines) {
-        if (line->last_access < min_access) {
-            min_access = line->last_access;
-            lru_line = line.get();
+    CacheLine* victim = nullptr;
+    int ties = 0;
+    if (policy == ReplacementPolicy::RANDOM) {
+        victim = lines[std::uniform_int_distribution<int>(0, associativity - 1)(rng)].get();
+    } else {
+        // If all valid, find the LRU line, equally old lines picked at random
+        for (auto& line : lines) {
+            if (!victim || line->last_access < victim->last_access) {
+                victim = line.get();
+                ties = 1;
+            } else if (line->last_access == victim->last_access && keepTie(++ties, rng)) {
+                victim = line.get();
+            }
         }
     }
     
     // Check if the line to be evicted is dirty, which requires a writeback
-    eviction_result = (lru_line->dirty) ? 2 : 1;  // 2 = dirty eviction, 1 = clean eviction
+    eviction_result = (victim->dirty) ? 2 : 1;  // 2 = dirty eviction, 1 = clean eviction
     
-    return lru_line;
+    return victim;
 }
 
-void CacheSet::updateLRU(CacheLine* line, int cycle) {
+void CacheSet::updateLRU(CacheLine* line, long long cycle) {
     line->last_access = cycle;
 }
@@ -2,50 +2,169 @@
 #include <cstdlib>
 #include <ctime>
 #include <random>
+#include <climits>
 
 CacheSimulator::CacheSimulator(const std::string& app_name, int s, int E, int b, 
-                               const std::string& output_file, int random_seed) : 
+                               const std::string& output_file, int random_seed,
+                               IndexFunction index_fn, ReplacementPolicy policy,
+                               const Topology& topology, bool collapse_runs) : 
     app_name(app_name),
     output_filename(output_file),
     s_bits(s),
     assoc(E),
     b_bits(b),
-    seed(random_seed) {
+    index_fn(index_fn),
+    policy(policy),
+    topology(topology),
+    seed(random_seed),
+    current_cycle(0) {
     
-    // Initialize random seed for tie breaking
+    init(app_name, collapse_runs);
+}
+
+CacheSimulator::CacheSimulator(int s, int E, int b, int random_seed, IndexFunction index_fn,
+                               ReplacementPolicy policy, const Topology& topology) : 
+    app_name("in-memory"),
+    s_bits(s),
+    assoc(E),
+    b_bits(b),
+    index_fn(index_fn),
+    policy(policy),
+    topology(topology),
+    seed(random_seed),
+    current_cycle(0) {
+    
+    init("");
+}
+
+void CacheSimulator::init(const std::string& trace_prefix, bool collapse_runs) {
+    // Draw a seed if none was given; each simulator has its own generator,
+    // so concurrent runs neither share nor race on random state
     if (seed == 0) {
         std::random_device rd;
         seed = rd();
     }
-    std::srand(seed);
+    rng = std::make_unique<std::mt19937>(seed);
     
-    // Create the bus
-    bus = std::make_unique<Bus>();
+    // Create one bus per socket, joined by the interconnect if there are several
+    if (topology.sockets > 1) {
+        interconnect = std::make_unique<Interconnect>(topology, 1 << b_bits);
+    }
+    for (int socket = 0; socket < topology.sockets; socket++) {
+        buses.push_back(std::make_unique<Bus>(socket));
+        if (interconnect) {
+            buses[socket]->setInterconnect(interconnect.get());
+            interconnect->addBus(buses[socket].get());
+        }
+    }
     
-    // Create caches and cores
-    for (int i = 0; i < 4; i++) {  // Quad core
-        caches.push_back(std::make_unique<Cache>(i, s, E, b, bus.get()));
+    // Create caches and cores, numbered socket by socket
+    for (int i = 0; i < topology.getNumCores(); i++) {
+        Bus* bus = buses[i / topology.cores_per_socket].get();
+        caches.push_back(std::make_unique<Cache>(i, s_bits, assoc, b_bits, bus, *rng, index_fn, policy));
         bus->addCache(caches[i].get());
         
+        if (trace_prefix.empty()) {
+            cores.push_back(std::make_unique<Core>(i, caches[i].get()));
+            continue;
+        }
+        
         // Create core with its trace file
-        std::string trace_filename = app_name + "_proc" + std::to_string(i) + ".trace";
-        std::cout << trace_filename << std::endl;
-        cores.push_back(std::make_unique<Core>(i, caches[i].get(), trace_filename));
+        std::string trace_filename = trace_prefix + "_proc" + std::to_string(i) + ".trace";
+        if (!collapse_runs) {
+            cores.push_back(std::make_unique<Core>(i, caches[i].get(), trace_filename));
+            if (!cores[i]->isTraceOpen() && error.empty()) {
+                error = "Could not open trace file: " + trace_filename;
+            }
+            continue;
+        }
+        
+        // Runs are only known once the whole trace is in memory
+        auto accesses = std::make_shared<std::vector<MemoryAccess>>();
+        if (!Core::loadTrace(trace_filename, *accesses) && error.empty()) {
+            error = "Could not open trace file: " + trace_filename;
+        }
+        cores.push_back(std::make_unique<Core>(i, caches[i].get()));
+        feedRuns(i, accesses);
+    }
+    active_cores.assign(cores.size(), false);
+}
+
+bool CacheSimulator::isFeedable(int core_id) const {
+    // Trace-backed cores never look at queued accesses
+    return core_id >= 0 && core_id < (int)cores.size() && cores[core_id]->isFromMemory();
+}
+
+bool CacheSimulator::access(int core_id, const MemoryAccess* accesses, size_t count) {
+    if (!isFeedable(core_id)) {
+        return false;
     }
+    // One copy and one allocation per batch
+    cores[core_id]->feed(std::make_shared<const std::vector<MemoryAccess>>(accesses, accesses + count));
+    return true;
+}
+
+bool CacheSimulator::access(int core_id, const std::vector<MemoryAccess>& accesses) {
+    return access(core_id, accesses.data(), accesses.size());
+}
+
+bool CacheSimulator::feed(int core_id, std::shared_ptr<const std::vector<MemoryAccess>> accesses) {
+    if (!isFeedable(core_id)) {
+        return false;
+    }
+    cores[core_id]->feed(std::move(accesses));
+    return true;
+}
+
+bool CacheSimulator::feedRuns(int core_id, std::shared_ptr<const std::vector<MemoryAccess>> accesses) {
+    if (!isFeedable(core_id) || !accesses) {
+        return false;
+    }
+    auto runs = std::make_shared<std::vector<WeightedRecord>>();
+    Core::collapseRuns(*accesses, b_bits, *runs);
+    cores[core_id]->feedRuns(std::move(accesses), std::move(runs));
+    return true;
+}
+
+void CacheSimulator::setDebug(bool enabled) {
+    for (auto& bus : buses) {
+        bus->setDebug(enabled);
+    }
+}
+
+int CacheSimulator::getInvalidations() const {
+    int total = 0;
+    for (auto& bus : buses) {
+        total += bus->getInvalidations();
+    }
+    return total;
+}
+
+int CacheSimulator::getDataTraffic() const {
+    int total = 0;
+    for (auto& bus : buses) {
+        total += bus->getDataTraffic();
+    }
+    return total;
 }
 
 void CacheSimulator::run() {
-    int current_cycle = 0;
-    bool all_done = false;
+    bool all_done = !error.empty();  // Never simulate a partial trace set
     
     // Continue until all cores are done
     while (!all_done) {
         all_done = true;
+        long long next_cycle = LLONG_MAX;
+        
+        // Snoops are stamped with the cycle they happen in
+        for (auto& bus : buses) {
+            bus->setCurrentCycle(current_cycle);
+        }
         
         // Try to execute one instruction per core
-        for (int i = 0; i < cores.size(); i++) {
-            bool active = cores[i]->executeNextInstruction(current_cycle);
-            if (active) {
+        for (int i = 0; i < (int)cores.size(); i++) {
+            active_cores[i] = cores[i]->executeNextInstruction(current_cycle);
+            if (active_cores[i]) {
                 all_done = false;
             }
         }
@@ -53,7 +172,18 @@ void CacheSimulator::run() {
         // Break if all cores are done
         if (all_done) break;
         
-        current_cycle++;
+        // Only after every core ran, a later core may have cut short an
+        // earlier core's bulk hits in this cycle
+        for (int i = 0; i < (int)cores.size(); i++) {
+            if (active_cores[i]) {
+                cores[i]->resolveBulkHits();
+                next_cycle = std::min(next_cycle, std::max(current_cycle + 1, cores[i]->getNextCycle()));
+            }
+        }
+        
+        // Jump straight past cycles in which every core is stalled on a
+        // miss or computing through a trace gap
+        current_cycle = next_cycle;
     }
 }
 
@@ -68,16 +198,30 @@ void CacheSimulator::outputResults() {
     }
     
     // Output stream: either file or stdout
-    std::ostream& out = output_filename.empty() ? std::cout : outfile;
+    writeResults(output_filename.empty() ? std::cout : outfile);
     
+    if (!output_filename.empty()) {
+        outfile.close();
+    }
+}
+
+void CacheSimulator::writeResults(std::ostream& out) {
     out << "Cache Simulator Results for " << app_name << "\n";
     out << "===================================\n";
     out << "Cache parameters:\n";
     out << "  Set bits (s): " << s_bits << " (Sets: " << (1 << s_bits) << ")\n";
     out << "  Associativity (E): " << assoc << "\n";
     out << "  Block bits (b): " << b_bits << " (Block size: " << (1 << b_bits) << " bytes)\n";
+    out << "  Index function: " << IndexFunctionToString(index_fn) << "\n";
+    out << "  Replacement policy: " << ReplacementPolicyToString(policy) << "\n";
     out << "  Total cache size per core: " << ((1 << s_bits) * assoc * (1 << b_bits)) << " bytes\n";
-    out << "  Random seed: " << seed << "\n\n";
+    out << "  Random seed: " << seed << "\n";
+    if (interconnect) {
+        out << "  Topology: " << topology.sockets << " sockets x " << topology.cores_per_socket
+            << " cores, link latency " << topology.link_latency << " cycles, link bandwidth "
+            << topology.link_bandwidth << " bytes/cycle, interleave " << topology.interleave << " bytes\n";
+    }
+    out << "\n";
     
     // Per-core statistics
     out << "Per-core Statistics:\n";
@@ -92,7 +236,7 @@ void CacheSimulator::outputResults() {
         << std::setw(15) << "Evictions" 
         << std::setw(15) << "Writebacks" << "\n";
     
-    for (int i = 0; i < cores.size(); i++) {
+    for (int i = 0; i < (int)cores.size(); i++) {
         out << std::setw(10) << i 
             << std::setw(15) << cores[i]->getReadCount() 
             << std::setw(15) << cores[i]->getWriteCount() 
@@ -107,22 +251,189 @@ void CacheSimulator::outputResults() {
     // Global statistics
     out << "\nGlobal Statistics:\n";
     out << "-----------------\n";
-    out << "Invalidations on bus: " << bus->getInvalidations() << "\n";
-    out << "Data traffic on bus: " << bus->getDataTraffic() << " bytes\n";
+    out << "Invalidations on bus: " << getInvalidations() << "\n";
+    out << "Data traffic on bus: " << getDataTraffic() << " bytes\n";
     out << "Maximum execution time: " << getMaxExecutionTime() << " cycles\n";
-    std::cout << "DEBUG: Before outputting stats, bus->getInvalidations()=" 
-          << bus->getInvalidations() << std::endl;
-    if (!output_filename.empty()) {
-        outfile.close();
+    if (buses[0]->isDebug()) {
+        std::cout << "DEBUG: Before outputting stats, bus->getInvalidations()=" 
+              << getInvalidations() << std::endl;
+    }
+    
+    if (interconnect) {
+        out << "\nPer-socket Statistics:\n";
+        out << "---------------------\n";
+        out << std::setw(10) << "Socket"
+            << std::setw(15) << "Local Misses"
+            << std::setw(15) << "Remote Misses"
+            << std::setw(15) << "Bus Inval"
+            << std::setw(15) << "Remote Inval"
+            << std::setw(15) << "Remote WBs"
+            << std::setw(15) << "Bus Traffic"
+            << std::setw(15) << "Link Traffic" << "\n";
+        for (int socket = 0; socket < (int)buses.size(); socket++) {
+            out << std::setw(10) << socket
+                << std::setw(15) << interconnect->getLocalMisses(socket)
+                << std::setw(15) << interconnect->getRemoteMisses(socket)
+                << std::setw(15) << buses[socket]->getInvalidations()
+                << std::setw(15) << interconnect->getRemoteInvalidations(socket)
+                << std::setw(15) << interconnect->getRemoteWritebacks(socket)
+                << std::setw(15) << buses[socket]->getDataTraffic()
+                << std::setw(15) << interconnect->getLinkTraffic(socket) << "\n";
+        }
+    }
+}
+
+void CacheSimulator::writeResultsJson(std::ostream& out) {
+    // Single line, so it can serve as one response of a line-based protocol
+    out << "{\"s\":" << s_bits
+        << ",\"E\":" << assoc
+        << ",\"b\":" << b_bits
+        << ",\"index\":\"" << IndexFunctionToString(index_fn) << "\""
+        << ",\"policy\":\"" << ReplacementPolicyToString(policy) << "\""
+        << ",\"seed\":" << seed
+        << ",\"cores\":[";
+    
+    for (int i = 0; i < (int)cores.size(); i++) {
+        const Core& core = *cores[i];
+        out << (i ? "," : "")
+            << "{\"id\":" << i
+            << ",\"reads\":" << core.getReadCount()
+            << ",\"writes\":" << core.getWriteCount()
+            << ",\"instructions\":" << core.getInstructionCount()
+            << ",\"total_cycles\":" << core.getTotalCycles()
+            << ",\"idle_cycles\":" << core.getIdleCycles()
+            << ",\"miss_rate\":" << std::fixed << std::setprecision(4) << core.getMissRate()
+            << ",\"evictions\":" << core.getEvictions()
+            << ",\"writebacks\":" << core.getWritebacks() << "}";
     }
+    
+    out << "],\"invalidations\":" << getInvalidations()
+        << ",\"data_traffic\":" << getDataTraffic()
+        << ",\"max_execution_time\":" << getMaxExecutionTime();
+    
+    if (interconnect) {
+        out << ",\"sockets\":[";
+        for (int socket = 0; socket < (int)buses.size(); socket++) {
+            out << (socket ? "," : "")
+                << "{\"id\":" << socket
+                << ",\"local_misses\":" << interconnect->getLocalMisses(socket)
+                << ",\"remote_misses\":" << interconnect->getRemoteMisses(socket)
+                << ",\"invalidations\":" << buses[socket]->getInvalidations()
+                << ",\"remote_invalidations\":" << interconnect->getRemoteInvalidations(socket)
+                << ",\"remote_writebacks\":" << interconnect->getRemoteWritebacks(socket)
+                << ",\"data_traffic\":" << buses[socket]->getDataTraffic()
+                << ",\"link_traffic\":" << interconnect->getLinkTraffic(socket) << "}";
+        }
+        out << "]";
+    }
+    out << "}";
+}
 
+std::vector<std::pair<std::string, double>> CacheSimulator::getStatistics() const {
+    std::vector<std::pair<std::string, double>> stats;
+    
+    for (int i = 0; i < (int)cores.size(); i++) {
+        const Core& core = *cores[i];
+        std::string prefix = "core" + std::to_string(i) + ".";
+        stats.emplace_back(prefix + "reads", core.getReadCount());
+        stats.emplace_back(prefix + "writes", core.getWriteCount());
+        stats.emplace_back(prefix + "instructions", core.getInstructionCount());
+        stats.emplace_back(prefix + "total_cycles", core.getTotalCycles());
+        stats.emplace_back(prefix + "idle_cycles", core.getIdleCycles());
+        stats.emplace_back(prefix + "miss_rate", core.getMissRate());
+        stats.emplace_back(prefix + "evictions", core.getEvictions());
+        stats.emplace_back(prefix + "writebacks", core.getWritebacks());
+    }
+    
+    stats.emplace_back("invalidations", getInvalidations());
+    stats.emplace_back("data_traffic", getDataTraffic());
+    stats.emplace_back("max_execution_time", getMaxExecutionTime());
+    
+    if (interconnect) {
+        for (int socket = 0; socket < (int)buses.size(); socket++) {
+            std::string prefix = "socket" + std::to_string(socket) + ".";
+            stats.emplace_back(prefix + "local_misses", interconnect->getLocalMisses(socket));
+            stats.emplace_back(prefix + "remote_misses", interconnect->getRemoteMisses(socket));
+            stats.emplace_back(prefix + "invalidations", buses[socket]->getInvalidations());
+            stats.emplace_back(prefix + "remote_invalidations", interconnect->getRemoteInvalidations(socket));
+            stats.emplace_back(prefix + "remote_writebacks", interconnect->getRemoteWritebacks(socket));
+            stats.emplace_back(prefix + "data_traffic", buses[socket]->getDataTraffic());
+            stats.emplace_back(prefix + "link_traffic", interconnect->getLinkTraffic(socket));
+        }
+    }
+    return stats;
+}
+
+void CacheSimulator::outputSetHeatmap(const std::string& filename) {
+    std::ofstream out(filename);
+    if (!out.is_open()) {
+        std::cerr << "Error: Could not open heatmap file: " << filename << std::endl;
+        return;
+    }
+    
+    out << "Per-set Conflict Heatmap for " << app_name << "\n";
+    out << "===================================\n";
+    out << "  Index function: " << IndexFunctionToString(index_fn) << "\n";
+    out << "  Usable sets: " << caches[0]->getUsableSets() << " of " << caches[0]->getNumSets() << "\n\n";
+    
+    // Summary: how evenly misses spread over the sets of each cache, only
+    // counting sets the index function can reach
+    out << "Per-core Miss Distribution:\n";
+    out << "--------------------------\n";
+    out << std::setw(10) << "Core ID"
+        << std::setw(15) << "Sets Used"
+        << std::setw(15) << "Max Misses"
+        << std::setw(15) << "Mean Misses"
+        << std::setw(15) << "Max/Mean"
+        << std::setw(15) << "Miss CV" << "\n";
+    
+    for (auto& cache : caches) {
+        int num_sets = cache->getUsableSets();
+        int sets_used = 0;
+        int max_misses = 0;
+        double sum = 0, sum_sq = 0;
+        for (int set = 0; set < num_sets; set++) {
+            int misses = cache->getSetMisses(set);
+            if (cache->getSetAccesses(set) > 0) sets_used++;
+            max_misses = std::max(max_misses, misses);
+            sum += misses;
+            sum_sq += (double)misses * misses;
+        }
+        double mean = sum / num_sets;
+        double stddev = std::sqrt(std::max(0.0, sum_sq / num_sets - mean * mean));
+        
+        out << std::setw(10) << cache->getCoreId()
+            << std::setw(15) << sets_used
+            << std::setw(15) << max_misses
+            << std::setw(15) << std::fixed << std::setprecision(4) << mean
+            << std::setw(15) << (mean > 0 ? max_misses / mean : 0.0)
+            << std::setw(15) << (mean > 0 ? stddev / mean : 0.0) << "\n";
+    }
+    
+    out << "\nPer-set Statistics:\n";
+    out << "-------------------\n";
+    out << std::setw(10) << "Core ID"
+        << std::setw(10) << "Set"
+        << std::setw(15) << "Accesses"
+        << std::setw(15) << "Misses"
+        << std::setw(15) << "Evictions" << "\n";
+    
+    for (auto& cache : caches) {
+        for (int set = 0; set < cache->getNumSets(); set++) {
+            out << std::setw(10) << cache->getCoreId()
+                << std::setw(10) << set
+                << std::setw(15) << cache->getSetAccesses(set)
+                << std::setw(15) << cache->getSetMisses(set)
+                << std::setw(15) << cache->getSetEvictions(set) << "\n";
+        }
+    }
 }
 
-int CacheSimulator::getMaxExecutionTime() {
-    int max_time = 0;
+long long CacheSimulator::getMaxExecutionTime() const {
+    long long max_time = 0;
     for (int i = 0; i < cores.size(); i++) {
         // Total execution time includes both active and idle cycles
-        int core_total_time = cores[i]->getTotalCycles() + cores[i]->getIdleCycles();
+        long long core_total_time = cores[i]->getTotalCycles() + cores[i]->getIdleCycles();
         max_time = std::max(max_time, core_total_time);
     }
     return max_time;
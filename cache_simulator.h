@@ -12,11 +12,20 @@
 #include <cassert>
 #include <memory>
 #include <map>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
+#include <random>
 
 // Forward declarations
 class Cache;
 class Core;
 class Bus;
+class Interconnect;
 
 // MESI protocol states
 enum class MESIState { MODIFIED, EXCLUSIVE, SHARED, INVALID };
@@ -32,13 +41,96 @@ inline std::string MESIStateToString(MESIState state) {
     }
 }
 
+// Set index functions
+enum class IndexFunction { MODULO, XOR_FOLD, SKEWED, PRIME };
+
+inline std::string IndexFunctionToString(IndexFunction fn) {
+    switch (fn) {
+        case IndexFunction::MODULO: return "modulo";
+        case IndexFunction::XOR_FOLD: return "xor";
+        case IndexFunction::SKEWED: return "skew";
+        case IndexFunction::PRIME: return "prime";
+        default: return "?";
+    }
+}
+
+inline bool parseIndexFunction(const std::string& name, IndexFunction& fn) {
+    for (IndexFunction f : { IndexFunction::MODULO, IndexFunction::XOR_FOLD,
+                             IndexFunction::SKEWED, IndexFunction::PRIME }) {
+        if (IndexFunctionToString(f) == name) {
+            fn = f;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Victim choice among the valid lines of a full set; invalid lines are
+// always filled first and ties are broken with the simulator's seed
+enum class ReplacementPolicy { LRU, RANDOM };
+
+inline std::string ReplacementPolicyToString(ReplacementPolicy policy) {
+    switch (policy) {
+        case ReplacementPolicy::LRU: return "lru";
+        case ReplacementPolicy::RANDOM: return "random";
+        default: return "?";
+    }
+}
+
+inline bool parseReplacementPolicy(const std::string& name, ReplacementPolicy& policy) {
+    for (ReplacementPolicy p : { ReplacementPolicy::LRU, ReplacementPolicy::RANDOM }) {
+        if (ReplacementPolicyToString(p) == name) {
+            policy = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Socket layout; the default is the original single quad-core bus
+struct Topology {
+    int sockets;
+    int cores_per_socket;
+    int link_latency;    // Cycles to cross the inter-socket link
+    int link_bandwidth;  // Bytes per cycle on the link, 0 = unlimited
+    int interleave;      // Bytes per home-node interleaving unit
+    
+    Topology() : 
+        sockets(1), 
+        cores_per_socket(4), 
+        link_latency(0), 
+        link_bandwidth(0), 
+        interleave(4096) {}
+    
+    int getNumCores() const { return sockets * cores_per_socket; }
+    bool load(const std::string& filename);
+    std::string toString() const;
+};
+
+// A single memory operation, as read from a trace line or fed in memory
+struct MemoryAccess {
+    char op;        // 'R' or 'W', 0 for a skipped (empty or malformed) trace line
+    uint32_t addr;
+    long long gap;  // Compute cycles (non-memory instructions) before this access
+};
+
+// Run of consecutive accesses by one core to the same block, built by
+// Core::collapseRuns for a given block size
+struct WeightedRecord {
+    uint32_t addr;  // Address of the first access
+    int first;      // Index of the first access in the core's access vector
+    int count;      // Accesses in the run
+    int reads;      // Reads among the accesses after the first
+    int writes;     // Writes among the accesses after the first
+};
+
 // Structure for a cache line
 struct CacheLine {
     bool valid;
     uint32_t tag;
     MESIState state;
     std::unique_ptr<uint8_t[]> data;
-    int last_access; // For LRU replacement
+    long long last_access; // For LRU replacement
     bool dirty;      // For write-back policy
     
     CacheLine(int block_size) : 
@@ -61,8 +153,13 @@ public:
     CacheSet(int E, int B);
     
     CacheLine* findLine(uint32_t tag);
-    CacheLine* findReplacementLine(int& eviction_result);
-    void updateLRU(CacheLine* line, int cycle);
+    CacheLine* findReplacementLine(int& eviction_result, ReplacementPolicy policy, std::mt19937& rng);
+    CacheLine* getLine(int way) { return lines[way].get(); }
+    
+    // Reservoir step: keep the ties-th equally good candidate with
+    // probability 1/ties, so each one ends up picked uniformly
+    static bool keepTie(int ties, std::mt19937& rng);
+    void updateLRU(CacheLine* line, long long cycle);
 };
 
 // L1 Cache class
@@ -77,6 +174,11 @@ private:
     
     int b_bits;     // b
     
+    IndexFunction index_fn;
+    int prime_sets; // Largest prime <= S, used by IndexFunction::PRIME
+    ReplacementPolicy policy;
+    std::mt19937* rng;  // The simulator's, shared by its caches
+    
     std::vector<CacheSet> cache_sets;
     Bus* bus;       // Reference to the shared bus
     
@@ -88,17 +190,54 @@ private:
     int evictions;
     int writebacks;
     
+    // Per-set statistics for conflict heatmaps
+    std::vector<int> set_accesses;
+    std::vector<int> set_misses;
+    std::vector<int> set_evictions;
+    
+    // Bulk hit run in progress
+    struct BulkRun {
+        CacheLine* line;
+        int set_idx;
+        long long start_cycle;
+        int count;
+        long long saved_last_access;
+        bool broken;
+        long long break_cycle;  // Cycle of the breaking snoop
+        int breaker_id;   // Core that issued it
+    };
+    bool bulk_active;
+    BulkRun bulk;
+    void noteSnoop(CacheLine* line, Cache* requester);
+    
+    uint32_t foldTag(uint32_t value) const;
+    int setIndex(uint32_t addr, int way) const;
+    CacheLine* findReplacementLine(uint32_t addr, int& set_idx, int& eviction_result);
+    uint32_t lineAddress(const CacheLine* line, int set_idx);  // Inverse of findLine
+    
 public:
-    Cache(int core_id, int s, int E, int b, Bus* bus);
+    Cache(int core_id, int s, int E, int b, Bus* bus, std::mt19937& rng,
+          IndexFunction index_fn = IndexFunction::MODULO,
+          ReplacementPolicy policy = ReplacementPolicy::LRU);
     
     // Core operations
-    bool read(uint32_t addr, int cycle, int& cycles_taken);
-    bool write(uint32_t addr, int cycle, int& cycles_taken);
+    bool read(uint32_t addr, long long cycle, int& cycles_taken);
+    bool write(uint32_t addr, long long cycle, int& cycles_taken);
     
     // Bus snooping operations
     void busRead(uint32_t addr, Cache* requester, int& data_transfer_cycles);
-    void busWrite(uint32_t addr, Cache* requester);
-    void busUpgrade(uint32_t addr);
+    // Return whether a line was invalidated
+    bool busWrite(uint32_t addr, Cache* requester);
+    bool busUpgrade(uint32_t addr, Cache* requester);
+    
+    // Bulk hits for a run of accesses to one block (see Core). The run is
+    // credited up front; a snoop changing the line's state while it is in
+    // progress marks it broken so the core can roll back the rest.
+    bool beginBulkHits(uint32_t addr, int reads, int writes, long long cycle, int count);
+    bool isBulkBroken() const { return bulk_active && bulk.broken; }
+    int getBulkHitsCompleted() const;
+    void rollbackBulkHits(int undone_reads, int undone_writes);
+    void endBulkHits() { bulk_active = false; }
     
     // Helper methods
     void extractAddressFields(uint32_t addr, uint32_t& tag, int& set_idx, uint32_t& block_offset);
@@ -111,6 +250,15 @@ public:
     int getEvictions() const { return evictions; }
     int getWritebacks() const { return writebacks; }
     int getCoreId() const { return core_id; }
+    int getBlockSize() const { return block_size; }
+    int getNumSets() const { return sets; }
+    
+    // Sets the index function can reach, the sets above the prime stay
+    // empty under IndexFunction::PRIME
+    int getUsableSets() const { return index_fn == IndexFunction::PRIME ? prime_sets : sets; }
+    int getSetAccesses(int set_idx) const { return set_accesses[set_idx]; }
+    int getSetMisses(int set_idx) const { return set_misses[set_idx]; }
+    int getSetEvictions(int set_idx) const { return set_evictions[set_idx]; }
 };
 
 // Processor core class
@@ -120,24 +268,79 @@ private:
     Cache* cache;
     std::ifstream trace_file;
     
+    // In-memory access source, used instead of trace_file when from_memory
+    struct TraceChunk {
+        std::shared_ptr<const std::vector<MemoryAccess>> accesses;
+        size_t pos;
+        size_t end;
+        
+        // Collapsed runs over accesses, nullptr to consume them one by one
+        std::shared_ptr<const std::vector<WeightedRecord>> runs;
+        size_t run_idx;
+        int run_offset;  // Accesses of runs[run_idx] already issued
+    };
+    bool from_memory;
+    std::deque<TraceChunk> pending;
+    bool nextMemoryAccess(MemoryAccess& access);
+    
     // Statistics
-    int total_cycles;
-    int idle_cycles;
+    long long total_cycles;
+    long long idle_cycles;
     int instruction_count;
-    bool is_stalled;
-    int stall_until_cycle;
+    long long compute_cycles;  // Part of total_cycles spent in trace gaps
+    bool is_stalled;           // Waiting on a miss or computing through a gap
+    long long stall_until_cycle;
+    
+    // Access whose compute gap is still running
+    bool has_deferred_access;
+    MemoryAccess deferred_access;
+    
+    // Tail of a run issued as bulk hits, kept until the run completes so
+    // it can be replayed one access at a time if another core breaks it
+    std::shared_ptr<const std::vector<MemoryAccess>> bulk_accesses;
+    int bulk_first;
+    int bulk_count;
+    long long bulk_start_cycle;
+    int collapsed_accesses;
+    bool tryBulkHits(long long current_cycle);
     
 public:
     Core(int id, Cache* cache, const std::string& trace_filename);
+    Core(int id, Cache* cache);  // Fed through feed() instead of a file
     ~Core();
     int getId() const { return id; }
-    bool executeNextInstruction(int current_cycle);
+    bool isFromMemory() const { return from_memory; }
+    bool isTraceOpen() const { return from_memory || trace_file.is_open(); }
+    bool executeNextInstruction(long long current_cycle);
     bool hasMoreInstructions();
     
+    // Takes back the part of a bulk run that another core's snoop cut
+    // short, the scheduler calls it once every core ran in a cycle
+    void resolveBulkHits();
+    
+    // First cycle at which executeNextInstruction() can make progress
+    long long getNextCycle() const { return is_stalled ? stall_until_cycle : 0; }
+    
+    // Trace reading (also used by the trace analyzer, which has no cache)
+    static bool parseTraceLine(const std::string& line, MemoryAccess& access);
+    bool readNextAccess(MemoryAccess& access);
+    static bool loadTrace(const std::string& filename, std::vector<MemoryAccess>& accesses);
+    
+    // Queue accesses for an in-memory core, the vector is shared, not copied
+    void feed(std::shared_ptr<const std::vector<MemoryAccess>> accesses);
+    
+    // Same, consuming same-block runs with bulk statistics updates
+    static void collapseRuns(const std::vector<MemoryAccess>& accesses, int b_bits,
+                             std::vector<WeightedRecord>& runs);
+    void feedRuns(std::shared_ptr<const std::vector<MemoryAccess>> accesses,
+                  std::shared_ptr<const std::vector<WeightedRecord>> runs);
+    
     // Statistics getters
-    int getTotalCycles() const { return total_cycles; }
-    int getIdleCycles() const { return idle_cycles; }
+    long long getTotalCycles() const { return total_cycles; }
+    long long getIdleCycles() const { return idle_cycles; }
     int getInstructionCount() const { return instruction_count; }
+    long long getComputeCycles() const { return compute_cycles; }
+    int getCollapsedAccesses() const { return collapsed_accesses; }
     int getReadCount() const { return cache->getReadCount(); }
     int getWriteCount() const { return cache->getWriteCount(); }
     float getMissRate() const { return cache->getMissRate(); }
@@ -151,20 +354,83 @@ private:
     std::vector<Cache*> caches;
     int invalidations;
     int data_traffic_bytes;
+    bool debug;  // Trace every bus transaction on stdout
+    
+    int socket_id;
+    Interconnect* interconnect;  // Other sockets, nullptr on a single socket
+    long long current_cycle;     // Cycle being simulated, for snoop ordering
+    
+    Cache* findCache(int core_id);
     
 public:
-    Bus();
+    Bus(int socket_id = 0);
     
     void addCache(Cache* cache);
+    void setInterconnect(Interconnect* link) { interconnect = link; }
+    void setCurrentCycle(long long cycle) { current_cycle = cycle; }
+    long long getCurrentCycle() const { return current_cycle; }
+    int getSocketId() const { return socket_id; }
+    
+    // Snoops issued on behalf of another socket. snoopRead returns the
+    // largest transfer time of a cache holding the block (0 if none),
+    // snoopInvalidate the number of lines actually invalidated.
+    int snoopRead(uint32_t addr, Cache* requester);
+    int snoopInvalidate(uint32_t addr, Cache* requester, bool upgrade);
     void processRead(int requester_id, uint32_t addr, int& cycles_taken);
     void processWrite(int requester_id, uint32_t addr, int& cycles_taken);
     void processUpgrade(int requester_id, uint32_t addr, int& cycles_taken);
+    int processWriteback(uint32_t addr);  // Returns the cycles a dirty eviction takes
     
     // Statistics getters
     int getInvalidations() const ;
     int getDataTraffic() const { return data_traffic_bytes; }
     void incrementInvalidations() { invalidations++; }
     void addDataTraffic(int bytes);
+    
+    void setDebug(bool enabled) { debug = enabled; }
+    bool isDebug() const { return debug; }
+};
+
+// Inter-socket coherence layer: forwards snoops that miss on the local
+// bus to the other sockets and models the link and home-node memory.
+// Remote snoops are assumed filtered, the link is only crossed when
+// another socket holds the block or is its home node.
+class Interconnect {
+private:
+    Topology topology;
+    int block_size;
+    std::vector<Bus*> buses;  // One per socket
+    
+    // Per-socket statistics, charged to the requesting socket
+    std::vector<int> local_misses;      // Served by a local cache or local memory
+    std::vector<int> remote_misses;     // Served by a remote cache or remote memory
+    std::vector<int> remote_invalidations;
+    std::vector<int> remote_writebacks;  // Dirty evictions sent to a remote home node
+    std::vector<int> link_traffic_bytes; // Data moved over the link
+    
+public:
+    Interconnect(const Topology& topology, int block_size);
+    
+    void addBus(Bus* bus) { buses.push_back(bus); }
+    int getHomeSocket(uint32_t addr) const;
+    int getLinkCycles(int bytes) const;
+    
+    // A miss the local bus could not serve from a local cache; returns
+    // the cycles to get the block from a remote cache or home memory
+    int fetchBlock(int socket, Cache* requester, uint32_t addr);
+    void recordLocalTransfer(int socket) { local_misses[socket]++; }
+    
+    // Invalidate copies on the other sockets; returns the extra cycles
+    int invalidateRemote(int socket, Cache* requester, uint32_t addr, bool upgrade);
+    
+    // Write a dirty block back to its home node's memory; returns the cycles
+    int writebackBlock(int socket, uint32_t addr);
+    
+    int getLocalMisses(int socket) const { return local_misses[socket]; }
+    int getRemoteMisses(int socket) const { return remote_misses[socket]; }
+    int getRemoteInvalidations(int socket) const { return remote_invalidations[socket]; }
+    int getRemoteWritebacks(int socket) const { return remote_writebacks[socket]; }
+    int getLinkTraffic(int socket) const { return link_traffic_bytes[socket]; }
 };
 
 // Main simulator class
@@ -172,23 +438,235 @@ class CacheSimulator {
 private:
     std::vector<std::unique_ptr<Core>> cores;
     std::vector<std::unique_ptr<Cache>> caches;
-    std::unique_ptr<Bus> bus;
+    std::vector<std::unique_ptr<Bus>> buses;  // One per socket
+    std::unique_ptr<Interconnect> interconnect;
     std::string app_name;
     std::string output_filename;
     int s_bits;  // Number of set index bits
     int assoc;   // Associativity
     int b_bits;  // Number of block bits
+    IndexFunction index_fn;
+    ReplacementPolicy policy;
+    Topology topology;
     
-    // Random seed for tie-breaking
+    // Random seed; rng, seeded with it, makes every random choice of the run.
+    // Held by pointer like the buses, so the caches' references survive a move.
     int seed;
+    std::unique_ptr<std::mt19937> rng;
+    
+    // Resumes here when run() is called again after more accesses are fed
+    long long current_cycle;
+    std::vector<bool> active_cores;  // Scratch for run(), one per core
+    
+    // First trace that could not be loaded, empty if all were
+    std::string error;
+    
+    void init(const std::string& trace_prefix, bool collapse_runs = false);
+    bool isFeedable(int core_id) const;
     
 public:
+    // Reads the four traces <app_name>_proc<i>.trace. With collapse_runs
+    // they are loaded up front and same-block runs hit in bulk.
     CacheSimulator(const std::string& app_name, int s, int E, int b, 
-                   const std::string& output_file, int random_seed = 0);
+                   const std::string& output_file, int random_seed = 0,
+                   IndexFunction index_fn = IndexFunction::MODULO,
+                   ReplacementPolicy policy = ReplacementPolicy::LRU,
+                   const Topology& topology = Topology(),
+                   bool collapse_runs = false);
+    
+    // Library use: no trace files, accesses are fed with access()/feed()
+    CacheSimulator(int s, int E, int b, int random_seed = 0,
+                   IndexFunction index_fn = IndexFunction::MODULO,
+                   ReplacementPolicy policy = ReplacementPolicy::LRU,
+                   const Topology& topology = Topology());
+    
+    // Queue a batch of accesses for a core. access() copies the batch once,
+    // feed() shares the caller's vector. Call run() to simulate them.
+    // All return false, queueing nothing, for an unknown core id or a core
+    // that reads a trace file.
+    bool access(int core_id, const MemoryAccess* accesses, size_t count);
+    bool access(int core_id, const std::vector<MemoryAccess>& accesses);
+    bool feed(int core_id, std::shared_ptr<const std::vector<MemoryAccess>> accesses);
+    
+    // Like feed(), collapsing runs of accesses to one block first
+    bool feedRuns(int core_id, std::shared_ptr<const std::vector<MemoryAccess>> accesses);
+    
+    // Why a trace-backed simulator could not load its traces, empty if it
+    // could. run() does nothing in that case.
+    const std::string& getError() const { return error; }
     
     void run();
+    void setDebug(bool enabled);
+    void writeResults(std::ostream& out);
+    void writeResultsJson(std::ostream& out);
+    
+    // Every per-core, bus and socket statistic as (name, value), in a fixed order
+    std::vector<std::pair<std::string, double>> getStatistics() const;
+    void outputResults();
+    void outputSetHeatmap(const std::string& filename);
+    long long getMaxExecutionTime() const;
+    
+    // Statistics access for library clients
+    int getNumCores() const { return cores.size(); }
+    const Core& getCore(int core_id) const { return *cores[core_id]; }
+    int getNumSockets() const { return buses.size(); }
+    const Bus& getBus(int socket = 0) const { return *buses[socket]; }
+    const Interconnect* getInterconnect() const { return interconnect.get(); }
+    int getInvalidations() const;
+    int getDataTraffic() const;
+    int getSeed() const { return seed; }
+};
+
+// Streaming LRU stack (reuse) distance tracker over block addresses.
+// Last-use timestamps are kept in a Fenwick tree that is compacted
+// whenever it fills, so memory stays proportional to the number of
+// distinct blocks rather than the trace length.
+class ReuseDistanceTracker {
+private:
+    std::unordered_map<uint32_t, int> last_use; // block -> timestamp slot
+    std::vector<int> tree;                      // Fenwick tree of live slots
+    int next_slot;
+    
+    // Bucket 0 holds distance 0, bucket k holds distances in [2^(k-1), 2^k)
+    std::vector<long long> histogram;
+    long long cold_accesses;
+    long long total_accesses;
+    
+    void treeAdd(int slot, int delta);
+    int treeSum(int slot) const;  // Number of live slots in [0, slot]
+    void compact();
+    
+public:
+    ReuseDistanceTracker();
+    
+    void access(uint32_t block);
+    
+    const std::vector<long long>& getHistogram() const { return histogram; }
+    long long getColdAccesses() const { return cold_accesses; }
+    long long getTotalAccesses() const { return total_accesses; }
+    int getUniqueBlocks() const { return last_use.size(); }
+};
+
+// Trace characterization mode: reuse-distance histograms, working-set
+// size per time window and block footprint, all in one streaming pass
+class TraceAnalyzer {
+private:
+    static const int NUM_CORES = 4;
+    static const int MIN_FOOTPRINT_BITS = 2;  // 4-byte blocks
+    static const int MAX_FOOTPRINT_BITS = 8;  // 256-byte blocks
+    
+    std::string app_name;
+    std::string output_filename;
+    int b_bits;       // Block bits used for reuse distance and working set
+    int window_size;  // Accesses (across all cores) per working-set window
+    
+    std::vector<ReuseDistanceTracker> core_reuse;
+    ReuseDistanceTracker global_reuse;
+    
+    // Distinct blocks per window: one row per window, global then per core
+    std::vector<std::vector<int>> working_sets;
+    
+    // Distinct blocks per block size, per core and global
+    std::vector<std::vector<int>> core_footprint;
+    std::vector<int> global_footprint;
+    
+    void outputHistogram(std::ostream& out, const std::string& title,
+                         const ReuseDistanceTracker& tracker);
+    
+public:
+    TraceAnalyzer(const std::string& app_name, int b, int window, 
+                  const std::string& output_file);
+    
+    bool run();  // False if a trace cannot be read
     void outputResults();
-    int getMaxExecutionTime();
+};
+
+// On-disk store of rendered results, keyed by a hash of the trace
+// contents and the full simulator configuration
+class ResultCache {
+private:
+    std::string directory;
+    
+    std::string entryPath(const std::string& key) const;
+    
+public:
+    ResultCache(const std::string& directory);
+    
+    // False if a trace file cannot be read
+    bool makeKey(const std::vector<std::string>& trace_files, 
+                 const std::string& config, std::string& key) const;
+    bool lookup(const std::string& key, std::string& results) const;
+    void store(const std::string& key, const std::string& results) const;
+    void invalidate(const std::string& key) const;
+};
+
+// Fixed-size worker pool
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable task_ready;
+    std::condition_variable all_done;
+    int active_tasks;
+    bool stopping;
+    
+    void workerLoop();
+    
+public:
+    ThreadPool(int num_workers);  // <= 0 uses the hardware thread count
+    ~ThreadPool();
+    
+    void submit(std::function<void()> task);
+    void wait();  // Until every submitted task has finished
+};
+
+// Runs one configuration under several seeds in parallel over shared
+// in-memory traces and aggregates every statistic across the runs
+class ReplicationRunner {
+private:
+    std::string app_name;
+    std::string output_filename;
+    int s_bits;
+    int assoc;
+    int b_bits;
+    IndexFunction index_fn;
+    ReplacementPolicy policy;
+    Topology topology;
+    std::vector<int> seeds;
+    int num_workers;
+    
+    // Statistics of each run, in seed order
+    std::vector<std::vector<std::pair<std::string, double>>> run_statistics;
+    
+public:
+    ReplicationRunner(const std::string& app_name, int s, int E, int b,
+                      const std::string& output_file, IndexFunction index_fn,
+                      ReplacementPolicy policy, const Topology& topology, const std::vector<int>& seeds, int num_workers);
+    
+    bool run();  // False if a trace cannot be read
+    void outputResults();
+};
+
+// Daemon mode: keeps the traces of several applications in memory and
+// answers configuration queries over a Unix domain socket
+class SimulationServer {
+private:
+    typedef std::vector<std::shared_ptr<const std::vector<MemoryAccess>>> AppTraces;
+    
+    std::string socket_path;
+    std::map<std::string, AppTraces> traces;  // Per app, one trace per core
+    ThreadPool pool;
+    
+    void handleConnection(int client_fd);
+    std::string handleRequest(const std::string& request);
+    std::string runQuery(const std::string& request);  // On a pool worker
+    
+public:
+    SimulationServer(const std::string& socket_path, int num_workers);
+    
+    bool loadApplication(const std::string& app_name);
+    int serve();  // Only returns on error
 };
 
 #endif // CACHE_SIMULATOR_H
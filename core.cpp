@@ -1,22 +1,47 @@
 #include "cache_simulator.h"
 #include <sstream>
+#include <stdexcept>
+
+// Largest compute gap of one access, keeps the 64-bit cycle counters far
+// from overflowing even over billions of accesses
+static const long long MAX_GAP = 1LL << 40;
 
 Core::Core(int id, Cache* cache, const std::string& trace_filename) : 
     id(id), 
     cache(cache), 
+    from_memory(false),
     total_cycles(0),
     idle_cycles(0),
     instruction_count(0),
+    compute_cycles(0),
     is_stalled(false),
-    stall_until_cycle(0) {
+    stall_until_cycle(0),
+    has_deferred_access(false),
+    bulk_first(0),
+    bulk_count(0),
+    bulk_start_cycle(0),
+    collapsed_accesses(0) {
     
+    // The owner checks isTraceOpen(), an unopened trace just ends at once
     trace_file.open(trace_filename);
-    if (!trace_file.is_open()) {
-        std::cerr << "Error: Could not open trace file: " << trace_filename << std::endl;
-        exit(1);
-    }
 }
 
+Core::Core(int id, Cache* cache) : 
+    id(id), 
+    cache(cache), 
+    from_memory(true),
+    total_cycles(0),
+    idle_cycles(0),
+    instruction_count(0),
+    compute_cycles(0),
+    is_stalled(false),
+    stall_until_cycle(0),
+    has_deferred_access(false),
+    bulk_first(0),
+    bulk_count(0),
+    bulk_start_cycle(0),
+    collapsed_accesses(0) {}
+
 Core::~Core() {
     if (trace_file.is_open()) {
         trace_file.close();
@@ -24,49 +49,281 @@ Core::~Core() {
 }
 
 bool Core::hasMoreInstructions() {
+    if (from_memory) {
+        return !pending.empty();
+    }
     return trace_file.good() && !trace_file.eof();
 }
 
-bool Core::executeNextInstruction(int current_cycle) {
-    // If stalled, just update idle cycles and return true (still active)
-    if (is_stalled && current_cycle < stall_until_cycle) {
-        idle_cycles++;
-        return true;  // Still active but stalled
+void Core::feed(std::shared_ptr<const std::vector<MemoryAccess>> accesses) {
+    if (accesses && !accesses->empty()) {
+        pending.push_back({ accesses, 0, accesses->size(), nullptr, 0, 0 });
+    }
+}
+
+void Core::collapseRuns(const std::vector<MemoryAccess>& accesses, int b_bits,
+                        std::vector<WeightedRecord>& runs) {
+    for (int i = 0; i < (int)accesses.size(); i++) {
+        const MemoryAccess& access = accesses[i];
+        bool is_rw = access.op == 'R' || access.op == 'r' || access.op == 'W' || access.op == 'w';
+        
+        // Extend the current run with back-to-back accesses to its block
+        if (!runs.empty() && is_rw && access.gap == 0) {
+            WeightedRecord& run = runs.back();
+            const MemoryAccess& first = accesses[run.first];
+            bool first_rw = first.op == 'R' || first.op == 'r' || first.op == 'W' || first.op == 'w';
+            if (first_rw && (first.addr >> b_bits) == (access.addr >> b_bits)) {
+                run.count++;
+                if (access.op == 'R' || access.op == 'r') {
+                    run.reads++;
+                } else {
+                    run.writes++;
+                }
+                continue;
+            }
+        }
+        runs.push_back({ access.addr, i, 1, 0, 0 });
+    }
+}
+
+void Core::feedRuns(std::shared_ptr<const std::vector<MemoryAccess>> accesses,
+                    std::shared_ptr<const std::vector<WeightedRecord>> runs) {
+    if (accesses && runs && !runs->empty()) {
+        pending.push_back({ accesses, 0, accesses->size(), runs, 0, 0 });
+    }
+}
+
+bool Core::nextMemoryAccess(MemoryAccess& access) {
+    if (pending.empty()) {
+        return false;
     }
     
-    is_stalled = false;
+    TraceChunk& chunk = pending.front();
+    bool consumed;
+    if (chunk.runs) {
+        const WeightedRecord& run = (*chunk.runs)[chunk.run_idx];
+        access = (*chunk.accesses)[run.first + chunk.run_offset++];
+        if (chunk.run_offset == run.count) {
+            chunk.run_idx++;
+            chunk.run_offset = 0;
+        }
+        consumed = chunk.run_idx == chunk.runs->size();
+    } else {
+        access = (*chunk.accesses)[chunk.pos++];
+        consumed = chunk.pos == chunk.end;
+    }
+    
+    // Drop the chunk (and possibly its storage) once consumed
+    if (consumed) {
+        pending.pop_front();
+    }
+    return true;
+}
+
+bool Core::tryBulkHits(long long current_cycle) {
+    // Only right after the first access of a run, which brought the block in
+    if (pending.empty() || !pending.front().runs || pending.front().run_offset != 1) {
+        return false;
+    }
     
-    // Check if there are more instructions in the trace file
-    if (trace_file.eof() || !trace_file.good()) {
-        return false;  // No more instructions, core is done
+    TraceChunk& chunk = pending.front();
+    const WeightedRecord& run = (*chunk.runs)[chunk.run_idx];
+    int count = run.count - 1;
+    if (!cache->beginBulkHits(run.addr, run.reads, run.writes, current_cycle, count)) {
+        return false;  // Would need the bus, issue one by one
     }
     
-    // Read the next instruction
-    std::string line;
-    std::getline(trace_file, line);
+    // The tail takes one cycle per access, just like single hits
+    bulk_accesses = chunk.accesses;
+    bulk_first = run.first + 1;
+    bulk_count = count;
+    bulk_start_cycle = current_cycle;
+    instruction_count += count;
+    total_cycles += count;
+    collapsed_accesses += count;
+    is_stalled = true;
+    stall_until_cycle = current_cycle + count;
     
-    // Skip empty lines and try again
-    if (line.empty()) {
-        return true;  // Skip empty line but stay active
+    chunk.run_idx++;
+    chunk.run_offset = 0;
+    if (chunk.run_idx == chunk.runs->size()) {
+        pending.pop_front();
+    }
+    return true;
+}
+
+void Core::resolveBulkHits() {
+    if (bulk_count == 0 || !cache->isBulkBroken()) {
+        return;
     }
     
-    // Parse instruction
-    char op;
+    // Another core took the line away mid-run: keep the hits issued before
+    // the snoop and replay the rest one by one from where it happened
+    int done = cache->getBulkHitsCompleted();
+    int undone_reads = 0, undone_writes = 0;
+    for (int i = bulk_first + done; i < bulk_first + bulk_count; i++) {
+        char op = (*bulk_accesses)[i].op;
+        if (op == 'R' || op == 'r') {
+            undone_reads++;
+        } else {
+            undone_writes++;
+        }
+    }
+    cache->rollbackBulkHits(undone_reads, undone_writes);
+    
+    int undone = bulk_count - done;
+    instruction_count -= undone;
+    total_cycles -= undone;
+    collapsed_accesses -= undone;
+    stall_until_cycle = bulk_start_cycle + done;
+    if (undone > 0) {
+        pending.push_front({ bulk_accesses, (size_t)(bulk_first + done),
+                             (size_t)(bulk_first + bulk_count), nullptr, 0, 0 });
+    }
+    bulk_accesses.reset();
+    bulk_count = 0;
+}
+
+bool Core::parseTraceLine(const std::string& line, MemoryAccess& access) {
     std::string addr_str;
     std::stringstream ss(line);
-    ss >> op >> addr_str;
+    ss >> access.op >> addr_str;
     
     // Check if parsing succeeded
     if (ss.fail()) {
-        return true;  // Skip malformed lines but stay active
+        return false;
     }
     
     // Convert hexadecimal address string to uint32_t
-    uint32_t addr;
     if (addr_str.substr(0, 2) == "0x") {
         addr_str = addr_str.substr(2);  // Remove "0x" prefix
     }
-    addr = std::stoul(addr_str, nullptr, 16);
+    size_t parsed = 0;
+    unsigned long value;
+    try {
+        value = std::stoul(addr_str, &parsed, 16);
+    } catch (const std::exception&) {
+        return false;  // Not a hexadecimal address
+    }
+    if (parsed != addr_str.size() || value > UINT32_MAX) {
+        return false;  // Trailing junk or more than 32 bits
+    }
+    access.addr = value;
+    
+    // Optional third column: compute cycles since the previous access
+    access.gap = 0;
+    if (!(ss >> std::ws).eof()) {
+        if (!(ss >> access.gap) || access.gap < 0 || access.gap > MAX_GAP) {
+            return false;  // Negative or out of range gap
+        }
+        if (!(ss >> std::ws).eof()) {
+            return false;  // Trailing characters after the gap, e.g. "12abc"
+        }
+    }
+    return true;
+}
+
+bool Core::readNextAccess(MemoryAccess& access) {
+    std::string line;
+    while (std::getline(trace_file, line)) {
+        // Skip empty and malformed lines
+        if (!line.empty() && parseTraceLine(line, access)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Core::loadTrace(const std::string& filename, std::vector<MemoryAccess>& accesses) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        return false;
+    }
+    
+    // Empty and malformed lines become no-op records, the file reader
+    // spends a cycle on each of them too
+    std::string line;
+    MemoryAccess access;
+    while (std::getline(file, line)) {
+        if (line.empty() || !parseTraceLine(line, access)) {
+            access = { 0, 0, 0 };
+        }
+        accesses.push_back(access);
+    }
+    return true;
+}
+
+bool Core::executeNextInstruction(long long current_cycle) {
+    resolveBulkHits();
+    
+    // Stalled or computing: those cycles were already accounted for when
+    // the stall began, so the scheduler may skip over them
+    if (is_stalled && current_cycle < stall_until_cycle) {
+        return true;  // Still active but stalled
+    }
+    
+    is_stalled = false;
+    
+    // A bulk run that got this far went through untouched
+    if (bulk_count > 0) {
+        cache->endBulkHits();
+        bulk_accesses.reset();
+        bulk_count = 0;
+    }
+    
+    MemoryAccess access;
+    
+    if (has_deferred_access) {
+        // Compute gap before this access is over
+        access = deferred_access;
+        has_deferred_access = false;
+    } else {
+        if (from_memory) {
+            // The rest of a same-block run may hit in one step
+            if (tryBulkHits(current_cycle)) {
+                return true;
+            }
+            
+            // Accesses fed directly by a library client
+            if (!nextMemoryAccess(access)) {
+                return false;  // Nothing queued, core is done
+            }
+            if (access.op == 0) {
+                return true;  // Skipped trace line, like in a file
+            }
+        } else {
+            // Check if there are more instructions in the trace file
+            if (trace_file.eof() || !trace_file.good()) {
+                return false;  // No more instructions, core is done
+            }
+            
+            // Read the next instruction
+            std::string line;
+            std::getline(trace_file, line);
+            
+            // Skip empty lines and try again
+            if (line.empty()) {
+                return true;  // Skip empty line but stay active
+            }
+            
+            // Parse instruction
+            if (!parseTraceLine(line, access)) {
+                return true;  // Skip malformed lines but stay active
+            }
+        }
+        
+        // Non-memory instructions before the access run back to back,
+        // the access itself issues once they are done
+        if (access.gap > 0) {
+            total_cycles += access.gap;
+            compute_cycles += access.gap;
+            is_stalled = true;
+            stall_until_cycle = current_cycle + access.gap;
+            deferred_access = access;
+            has_deferred_access = true;
+            return true;
+        }
+    }
     
     // Update instruction count
     instruction_count++;
@@ -75,12 +332,12 @@ bool Core::executeNextInstruction(int current_cycle) {
     int cycles_taken = 0;
     bool hit = false;
     
-    if (op == 'R' || op == 'r') {
-        hit = cache->read(addr, current_cycle, cycles_taken);
-    } else if (op == 'W' || op == 'w') {
-        hit = cache->write(addr, current_cycle, cycles_taken);
+    if (access.op == 'R' || access.op == 'r') {
+        hit = cache->read(access.addr, current_cycle, cycles_taken);
+    } else if (access.op == 'W' || access.op == 'w') {
+        hit = cache->write(access.addr, current_cycle, cycles_taken);
     } else {
-        std::cerr << "Warning: Unknown operation type: " << op << std::endl;
+        std::cerr << "Warning: Unknown operation type: " << access.op << std::endl;
         return true;  // Skip unknown operations but stay active
     }
     
@@ -90,10 +347,11 @@ bool Core::executeNextInstruction(int current_cycle) {
     if (!hit) {
         is_stalled = true;
         stall_until_cycle = current_cycle + cycles_taken;
-        // Future cycles during stall will be counted as idle_cycles
+        // The cycles strictly between now and stall_until_cycle are idle
+        idle_cycles += std::max(0, cycles_taken - 1);
     }
     
     // Always return true when we've processed an instruction
     // This keeps the core active in the simulation
     return true;
-}
\ No newline at end of file
+}
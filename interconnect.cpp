@@ -0,0 +1,132 @@
+#include "cache_simulator.h"
+#include <sstream>
+
+// Topology file: one "key value" pair per line, '#' starts a comment
+//   sockets 2
+//   cores_per_socket 2
+//   link_latency 40
+//   link_bandwidth 16
+//   interleave 4096
+bool Topology::load(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not open topology file: " << filename << std::endl;
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+        std::stringstream ss(line);
+        std::string key;
+        int value;
+        if (!(ss >> key)) {
+            continue;  // Blank or comment line
+        }
+        if (!(ss >> value)) {
+            std::cerr << "Error: Missing value for " << key << " in " << filename << std::endl;
+            return false;
+        }
+
+        if (key == "sockets") {
+            sockets = value;
+        } else if (key == "cores_per_socket") {
+            cores_per_socket = value;
+        } else if (key == "link_latency") {
+            link_latency = value;
+        } else if (key == "link_bandwidth") {
+            link_bandwidth = value;
+        } else if (key == "interleave") {
+            interleave = value;
+        } else {
+            std::cerr << "Error: Unknown topology key: " << key << std::endl;
+            return false;
+        }
+    }
+
+    if (sockets <= 0 || cores_per_socket <= 0 || link_latency < 0 ||
+        link_bandwidth < 0 || interleave <= 0) {
+        std::cerr << "Error: Invalid topology in " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::string Topology::toString() const {
+    std::ostringstream out;
+    out << "sockets=" << sockets
+        << " cores_per_socket=" << cores_per_socket
+        << " link_latency=" << link_latency
+        << " link_bandwidth=" << link_bandwidth
+        << " interleave=" << interleave;
+    return out.str();
+}
+
+Interconnect::Interconnect(const Topology& topology, int block_size) :
+    topology(topology),
+    block_size(block_size),
+    local_misses(topology.sockets, 0),
+    remote_misses(topology.sockets, 0),
+    remote_invalidations(topology.sockets, 0),
+    remote_writebacks(topology.sockets, 0),
+    link_traffic_bytes(topology.sockets, 0) {}
+
+int Interconnect::getHomeSocket(uint32_t addr) const {
+    return (addr / topology.interleave) % topology.sockets;
+}
+
+int Interconnect::getLinkCycles(int bytes) const {
+    int cycles = topology.link_latency;
+    if (topology.link_bandwidth > 0) {
+        cycles += (bytes + topology.link_bandwidth - 1) / topology.link_bandwidth;
+    }
+    return cycles;
+}
+
+int Interconnect::fetchBlock(int socket, Cache* requester, uint32_t addr) {
+    // Another socket's cache supplies the block over the link
+    int max_cycles = 0;
+    for (Bus* bus : buses) {
+        if (bus->getSocketId() != socket) {
+            max_cycles = std::max(max_cycles, bus->snoopRead(addr, requester));
+        }
+    }
+    if (max_cycles > 0) {
+        remote_misses[socket]++;
+        link_traffic_bytes[socket] += block_size;
+        return max_cycles + getLinkCycles(block_size);
+    }
+
+    // Otherwise memory, local or across the link to the home node
+    if (getHomeSocket(addr) == socket) {
+        local_misses[socket]++;
+        return 100;
+    }
+    remote_misses[socket]++;
+    link_traffic_bytes[socket] += block_size;
+    return 100 + getLinkCycles(block_size);
+}
+
+int Interconnect::invalidateRemote(int socket, Cache* requester, uint32_t addr, bool upgrade) {
+    int invalidated = 0;
+    for (Bus* bus : buses) {
+        if (bus->getSocketId() != socket) {
+            invalidated += bus->snoopInvalidate(addr, requester, upgrade);
+        }
+    }
+    remote_invalidations[socket] += invalidated;
+
+    // One round trip over the link when any remote copy had to go
+    return invalidated > 0 ? topology.link_latency : 0;
+}
+
+int Interconnect::writebackBlock(int socket, uint32_t addr) {
+    if (getHomeSocket(addr) == socket) {
+        return 100;
+    }
+    
+    // The block crosses the link to its home node's memory
+    remote_writebacks[socket]++;
+    link_traffic_bytes[socket] += block_size;
+    return 100 + getLinkCycles(block_size);
+}
@@ -1,5 +1,21 @@
 #include "cache_simulator.h"
 #include <cstring>
+#include <sstream>
+
+// Writes text to the output file, or stdout when no file is given
+static bool writeOutput(const std::string& output_file, const std::string& text) {
+    if (output_file.empty()) {
+        std::cout << text;
+        return true;
+    }
+    std::ofstream outfile(output_file);
+    if (!outfile.is_open()) {
+        std::cerr << "Error: Could not open output file: " << output_file << std::endl;
+        return false;
+    }
+    outfile << text;
+    return true;
+}
 
 void printHelp() {
     std::cout << "Usage: ./L1simulate [options]" << std::endl;
@@ -9,6 +25,21 @@ void printHelp() {
     std::cout << "  -E <E>: associativity (number of cache lines per set)" << std::endl;
     std::cout << "  -b <b>: number of block bits (block size = B = 2^b)" << std::endl;
     std::cout << "  -o <outfilename>: logs output in file for plotting etc." << std::endl;
+    std::cout << "  -i <fn>: set index function: modulo (default), xor, skew (skewed-associative) or prime" << std::endl;
+    std::cout << "  -p <policy>: replacement policy: lru (default) or random, ties always broken with the seed" << std::endl;
+    std::cout << "  -H <heatmapfile>: writes per-set access/miss/eviction counts for each core" << std::endl;
+    std::cout << "  -T <topologyfile>: multi-socket topology (sockets, cores_per_socket, link_latency, link_bandwidth, interleave)" << std::endl;
+    std::cout << "  -r <seed>: random seed for replacement decisions (default: drawn at random)" << std::endl;
+    std::cout << "  -K <runs>: replicate the run with seeds r, r+1, ... (r from -r, default 1) and report mean/std/min/max" << std::endl;
+    std::cout << "  -R <seeds>: replicate the run with the given comma separated (non-zero) seeds" << std::endl;
+    std::cout << "  -C <dir>: result cache directory (default .l1sim_cache)" << std::endl;
+    std::cout << "  -N: bypass the result cache, neither read nor write it" << std::endl;
+    std::cout << "  -I: invalidate the cached result for this run and simulate again" << std::endl;
+    std::cout << "  -P: collapse runs of accesses to the same block and account their hits in bulk (same results, faster)" << std::endl;
+    std::cout << "  -D <socket>: daemon mode, preloads the traces of every application in -t (comma separated) and answers queries on a Unix socket" << std::endl;
+    std::cout << "  -j <workers>: worker threads for daemon and replication modes (default: hardware threads)" << std::endl;
+    std::cout << "  -a: analysis mode, reports reuse distance, working set and footprint of the traces (needs only -t, -b)" << std::endl;
+    std::cout << "  -w <window>: working-set window in accesses for analysis mode (default 1000)" << std::endl;
     std::cout << "  -h: prints this help" << std::endl;
 }
 
@@ -16,6 +47,21 @@ int main(int argc, char* argv[]) {
     std::string app_name;
     int s = 0, E = 0, b = 0;
     std::string output_file;
+    std::string heatmap_file;
+    IndexFunction index_fn = IndexFunction::MODULO;
+    ReplacementPolicy policy = ReplacementPolicy::LRU;
+    Topology topology;
+    int seed = 0;
+    int replications = 0;
+    std::vector<int> seed_list;
+    std::string cache_dir = ".l1sim_cache";
+    bool use_cache = true;
+    bool invalidate_cache = false;
+    bool collapse_runs = false;
+    std::string socket_path;
+    int workers = 0;
+    bool analyze = false;
+    int window = 1000;
     
     // Parse command line arguments
     for (int i = 1; i < argc; i++) {
@@ -29,12 +75,89 @@ int main(int argc, char* argv[]) {
             b = atoi(argv[++i]);
         } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
             output_file = argv[++i];
+        } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+            if (!parseIndexFunction(argv[++i], index_fn)) {
+                std::cerr << "Error: Unknown index function: " << argv[i] << std::endl;
+                printHelp();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            if (!parseReplacementPolicy(argv[++i], policy)) {
+                std::cerr << "Error: Unknown replacement policy: " << argv[i] << std::endl;
+                printHelp();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-H") == 0 && i + 1 < argc) {
+            heatmap_file = argv[++i];
+        } else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc) {
+            if (!topology.load(argv[++i])) {
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            seed = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-K") == 0 && i + 1 < argc) {
+            replications = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-R") == 0 && i + 1 < argc) {
+            std::stringstream seeds(argv[++i]);
+            std::string value;
+            while (std::getline(seeds, value, ',')) {
+                seed_list.push_back(atoi(value.c_str()));
+            }
+        } else if (strcmp(argv[i], "-C") == 0 && i + 1 < argc) {
+            cache_dir = argv[++i];
+        } else if (strcmp(argv[i], "-N") == 0) {
+            use_cache = false;
+        } else if (strcmp(argv[i], "-I") == 0) {
+            invalidate_cache = true;
+        } else if (strcmp(argv[i], "-P") == 0) {
+            collapse_runs = true;
+        } else if (strcmp(argv[i], "-D") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-a") == 0) {
+            analyze = true;
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            window = atoi(argv[++i]);
         } else if (strcmp(argv[i], "-h") == 0) {
             printHelp();
             return 0;
         }
     }
     
+    // Daemon mode: cache parameters come with each query
+    if (!socket_path.empty()) {
+        if (app_name.empty()) {
+            std::cerr << "Error: Missing or invalid required parameters" << std::endl;
+            printHelp();
+            return 1;
+        }
+        SimulationServer server(socket_path, workers);
+        std::stringstream apps(app_name);
+        std::string app;
+        while (std::getline(apps, app, ',')) {
+            if (!app.empty() && !server.loadApplication(app)) {
+                return 1;
+            }
+        }
+        return server.serve();
+    }
+    
+    // Analysis mode only needs the traces and a block size
+    if (analyze) {
+        if (app_name.empty() || b <= 0 || window <= 0) {
+            std::cerr << "Error: Missing or invalid required parameters" << std::endl;
+            printHelp();
+            return 1;
+        }
+        TraceAnalyzer analyzer(app_name, b, window, output_file);
+        if (!analyzer.run()) {
+            return 1;
+        }
+        analyzer.outputResults();
+        return 0;
+    }
+    
     // Check if required parameters are provided
     if (app_name.empty() || s <= 0 || E <= 0 || b <= 0) {
         std::cerr << "Error: Missing or invalid required parameters" << std::endl;
@@ -42,10 +165,79 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
+    // Replication mode: same configuration, several seeds in parallel
+    if (replications > 0 || !seed_list.empty()) {
+        if (seed_list.empty()) {
+            int first_seed = (seed != 0) ? seed : 1;
+            for (int r = 0; r < replications; r++) {
+                seed_list.push_back(first_seed + r);
+            }
+        }
+        // Seed 0 would draw a random seed and break reproducibility
+        if (std::find(seed_list.begin(), seed_list.end(), 0) != seed_list.end()) {
+            std::cerr << "Error: Replication seeds must be non-zero" << std::endl;
+            return 1;
+        }
+        ReplicationRunner runner(app_name, s, E, b, output_file, index_fn, policy, topology, seed_list, workers);
+        if (!runner.run()) {
+            return 1;
+        }
+        runner.outputResults();
+        return 0;
+    }
+    
+    // Consult the result cache; the heatmap is not cached, so asking for
+    // one always simulates. Without -r the seed is drawn at random and the
+    // run cannot be reproduced, so it is neither looked up nor stored.
+    ResultCache result_cache(cache_dir);
+    std::string cache_key;
+    if (use_cache && seed != 0) {
+        std::vector<std::string> trace_files;
+        for (int i = 0; i < topology.getNumCores(); i++) {
+            trace_files.push_back(app_name + "_proc" + std::to_string(i) + ".trace");
+        }
+        // The application name is part of the rendered results
+        std::ostringstream config;
+        config << "app=" << app_name << " s=" << s << " E=" << E << " b=" << b 
+               << " index=" << IndexFunctionToString(index_fn)
+               << " policy=" << ReplacementPolicyToString(policy) << " seed=" << seed
+               << " " << topology.toString() << (collapse_runs ? " collapse" : "");
+        
+        if (!result_cache.makeKey(trace_files, config.str(), cache_key)) {
+            cache_key.clear();  // Unreadable trace, let the simulator report it
+        } else if (invalidate_cache) {
+            result_cache.invalidate(cache_key);
+        } else if (heatmap_file.empty()) {
+            std::string cached;
+            if (result_cache.lookup(cache_key, cached)) {
+                return writeOutput(output_file, cached) ? 0 : 1;
+            }
+        }
+    }
+    
     // Create and run simulator
-    CacheSimulator simulator(app_name, s, E, b, output_file);
+    for (int i = 0; i < topology.getNumCores(); i++) {
+        std::cout << app_name << "_proc" << i << ".trace" << std::endl;
+    }
+    CacheSimulator simulator(app_name, s, E, b, output_file, seed, index_fn, policy, topology, collapse_runs);
+    if (!simulator.getError().empty()) {
+        std::cerr << "Error: " << simulator.getError() << std::endl;
+        return 1;
+    }
+    simulator.setDebug(true);
     simulator.run();
-    simulator.outputResults();
+    
+    std::ostringstream results;
+    simulator.writeResults(results);
+    if (!cache_key.empty()) {
+        result_cache.store(cache_key, results.str());
+    }
+    if (!writeOutput(output_file, results.str())) {
+        return 1;
+    }
+    if (!heatmap_file.empty()) {
+        simulator.outputSetHeatmap(heatmap_file);
+    }
     
     return 0;
 }
@@ -0,0 +1,131 @@
+#include "cache_simulator.h"
+
+// Two-sided 95% Student t critical values for 1..30 degrees of freedom
+static const double T_CRITICAL_95[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+ReplicationRunner::ReplicationRunner(const std::string& app_name, int s, int E, int b,
+                                     const std::string& output_file, IndexFunction index_fn,
+                                     ReplacementPolicy policy, const Topology& topology, const std::vector<int>& seeds,
+                                     int num_workers) :
+    app_name(app_name),
+    output_filename(output_file),
+    s_bits(s),
+    assoc(E),
+    b_bits(b),
+    index_fn(index_fn),
+    policy(policy),
+    topology(topology),
+    seeds(seeds),
+    num_workers(num_workers) {}
+
+bool ReplicationRunner::run() {
+    // Read every trace once, all runs share them read-only
+    std::vector<std::shared_ptr<const std::vector<MemoryAccess>>> traces;
+    for (int i = 0; i < topology.getNumCores(); i++) {
+        std::string trace_filename = app_name + "_proc" + std::to_string(i) + ".trace";
+        auto accesses = std::make_shared<std::vector<MemoryAccess>>();
+        if (!Core::loadTrace(trace_filename, *accesses)) {
+            std::cerr << "Error: Could not open trace file: " << trace_filename << std::endl;
+            return false;
+        }
+        traces.push_back(accesses);
+    }
+
+    // Each run writes only its own slot, so the output does not depend on
+    // which worker finishes first
+    run_statistics.assign(seeds.size(), {});
+    {
+        ThreadPool pool(num_workers);
+        for (int r = 0; r < (int)seeds.size(); r++) {
+            pool.submit([this, r, &traces] {
+                CacheSimulator simulator(s_bits, assoc, b_bits, seeds[r], index_fn, policy, topology);
+                for (int i = 0; i < (int)traces.size(); i++) {
+                    simulator.feed(i, traces[i]);
+                }
+                simulator.run();
+                run_statistics[r] = simulator.getStatistics();
+            });
+        }
+        pool.wait();
+    }
+    return true;
+}
+
+void ReplicationRunner::outputResults() {
+    std::ofstream outfile;
+    if (!output_filename.empty()) {
+        outfile.open(output_filename);
+        if (!outfile.is_open()) {
+            std::cerr << "Error: Could not open output file: " << output_filename << std::endl;
+            return;
+        }
+    }
+
+    // Output stream: either file or stdout
+    std::ostream& out = output_filename.empty() ? std::cout : outfile;
+    int runs = seeds.size();
+
+    out << "Replicated Cache Simulator Results for " << app_name << "\n";
+    out << "===================================\n";
+    out << "Cache parameters:\n";
+    out << "  Set bits (s): " << s_bits << " (Sets: " << (1 << s_bits) << ")\n";
+    out << "  Associativity (E): " << assoc << "\n";
+    out << "  Block bits (b): " << b_bits << " (Block size: " << (1 << b_bits) << " bytes)\n";
+    out << "  Index function: " << IndexFunctionToString(index_fn) << "\n";
+    out << "  Replacement policy: " << ReplacementPolicyToString(policy) << "\n";
+    if (topology.sockets > 1) {
+        out << "  Topology: " << topology.toString() << "\n";
+    }
+    out << "  Runs: " << runs << " (seeds:";
+    for (int seed : seeds) {
+        out << " " << seed;
+    }
+    out << ")\n\n";
+
+    out << std::setw(32) << "Statistic"
+        << std::setw(15) << "Mean"
+        << std::setw(15) << "Std Dev"
+        << std::setw(15) << "CI95 +/-"
+        << std::setw(15) << "Min"
+        << std::setw(15) << "Max" << "\n";
+
+    // Every run reports the same statistics in the same order
+    const auto& names = run_statistics[0];
+    for (int k = 0; k < (int)names.size(); k++) {
+        double sum = 0;
+        double min_value = run_statistics[0][k].second;
+        double max_value = min_value;
+        for (int r = 0; r < runs; r++) {
+            double value = run_statistics[r][k].second;
+            sum += value;
+            min_value = std::min(min_value, value);
+            max_value = std::max(max_value, value);
+        }
+        double mean = sum / runs;
+
+        // Sample standard deviation, summed in seed order for determinism
+        double squares = 0;
+        for (int r = 0; r < runs; r++) {
+            double diff = run_statistics[r][k].second - mean;
+            squares += diff * diff;
+        }
+        double stddev = runs > 1 ? std::sqrt(squares / (runs - 1)) : 0.0;
+        double t = runs > 31 ? 1.960 : (runs > 1 ? T_CRITICAL_95[runs - 2] : 0.0);
+        double half_width = runs > 1 ? t * stddev / std::sqrt(runs) : 0.0;
+
+        out << std::setw(32) << names[k].first
+            << std::setw(15) << std::fixed << std::setprecision(4) << mean
+            << std::setw(15) << stddev
+            << std::setw(15) << half_width
+            << std::setw(15) << min_value
+            << std::setw(15) << max_value << "\n";
+    }
+
+    if (!output_filename.empty()) {
+        outfile.close();
+    }
+}
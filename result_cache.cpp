@@ -0,0 +1,89 @@
+#include "cache_simulator.h"
+#include <sstream>
+#include <cstdio>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 64-bit FNV-1a
+static const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+static uint64_t hashBytes(const char* data, size_t size, uint64_t hash) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+ResultCache::ResultCache(const std::string& directory) : directory(directory) {}
+
+std::string ResultCache::entryPath(const std::string& key) const {
+    return directory + "/" + key + ".txt";
+}
+
+bool ResultCache::makeKey(const std::vector<std::string>& trace_files, 
+                          const std::string& config, std::string& key) const {
+    uint64_t hash = FNV_OFFSET;
+    
+    // Bump when the simulator's results change for the same inputs
+    const std::string version = "l1sim-results-v1\n";
+    hash = hashBytes(version.data(), version.size(), hash);
+    hash = hashBytes(config.data(), config.size(), hash);
+    
+    std::vector<char> buffer(1 << 16);
+    for (const std::string& filename : trace_files) {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+        
+        // Separate files so content moving between them changes the key
+        hash = hashBytes("\0", 1, hash);
+        while (file) {
+            file.read(buffer.data(), buffer.size());
+            hash = hashBytes(buffer.data(), file.gcount(), hash);
+        }
+    }
+    
+    std::ostringstream hex;
+    hex << std::hex << std::setw(16) << std::setfill('0') << hash;
+    key = hex.str();
+    return true;
+}
+
+bool ResultCache::lookup(const std::string& key, std::string& results) const {
+    std::ifstream entry(entryPath(key));
+    if (!entry.is_open()) {
+        return false;
+    }
+    
+    std::ostringstream contents;
+    contents << entry.rdbuf();
+    results = contents.str();
+    return true;
+}
+
+void ResultCache::store(const std::string& key, const std::string& results) const {
+    mkdir(directory.c_str(), 0755);  // Fails harmlessly if it exists
+    
+    // Write to a temporary file and rename, so concurrent sweeps never
+    // read a partially written entry
+    std::string temp_path = entryPath(key) + ".tmp" + std::to_string(getpid());
+    std::ofstream entry(temp_path);
+    if (!entry.is_open()) {
+        std::cerr << "Warning: Could not write result cache entry: " << temp_path << std::endl;
+        return;
+    }
+    entry << results;
+    entry.close();
+    
+    if (std::rename(temp_path.c_str(), entryPath(key).c_str()) != 0) {
+        std::cerr << "Warning: Could not write result cache entry: " << entryPath(key) << std::endl;
+        std::remove(temp_path.c_str());
+    }
+}
+
+void ResultCache::invalidate(const std::string& key) const {
+    std::remove(entryPath(key).c_str());
+}
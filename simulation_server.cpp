@@ -0,0 +1,238 @@
+#include "cache_simulator.h"
+#include <sstream>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <future>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Largest cache a client may ask for, so a bad query cannot exhaust memory
+static const int MAX_SET_BITS = 20;
+static const int MAX_BLOCK_BITS = 12;
+static const int MAX_ASSOC = 64;
+static const long long MAX_CACHE_BYTES = 1LL << 26;
+
+// Longest request line, a client that never sends a newline is cut off
+static const size_t MAX_REQUEST_BYTES = 4096;
+
+static std::string jsonEscape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            escaped += ' ';
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+static std::string errorResponse(const std::string& message) {
+    return "{\"status\":\"error\",\"message\":\"" + jsonEscape(message) + "\"}";
+}
+
+SimulationServer::SimulationServer(const std::string& socket_path, int num_workers) :
+    socket_path(socket_path),
+    pool(num_workers) {}
+
+bool SimulationServer::loadApplication(const std::string& app_name) {
+    AppTraces app_traces;
+    for (int i = 0; i < 4; i++) {
+        std::string trace_filename = app_name + "_proc" + std::to_string(i) + ".trace";
+        auto accesses = std::make_shared<std::vector<MemoryAccess>>();
+        if (!Core::loadTrace(trace_filename, *accesses)) {
+            std::cerr << "Error: Could not open trace file: " << trace_filename << std::endl;
+            return false;
+        }
+        app_traces.push_back(accesses);
+    }
+    traces[app_name] = app_traces;
+    return true;
+}
+
+// Request: space separated key=value pairs on one line, e.g.
+//   app=seq_add s=6 E=2 b=5 index=xor policy=random seed=1
+// or "apps" to list the preloaded applications. One JSON line is returned.
+std::string SimulationServer::handleRequest(const std::string& request) {
+    std::istringstream tokens(request);
+    std::string token;
+    std::string app_name;
+    int s = 0, E = 0, b = 0, seed = 0;
+    IndexFunction index_fn = IndexFunction::MODULO;
+    ReplacementPolicy policy = ReplacementPolicy::LRU;
+
+    if (request == "apps") {
+        std::string response = "{\"status\":\"ok\",\"apps\":[";
+        bool first = true;
+        for (auto& entry : traces) {
+            response += (first ? "\"" : ",\"") + jsonEscape(entry.first) + "\"";
+            first = false;
+        }
+        return response + "]}";
+    }
+
+    while (tokens >> token) {
+        size_t eq = token.find('=');
+        if (eq == std::string::npos) {
+            return errorResponse("Malformed field: " + token);
+        }
+        std::string key = token.substr(0, eq);
+        std::string value = token.substr(eq + 1);
+
+        if (key == "app") {
+            app_name = value;
+        } else if (key == "s") {
+            s = atoi(value.c_str());
+        } else if (key == "E") {
+            E = atoi(value.c_str());
+        } else if (key == "b") {
+            b = atoi(value.c_str());
+        } else if (key == "seed") {
+            seed = atoi(value.c_str());
+        } else if (key == "index") {
+            if (!parseIndexFunction(value, index_fn)) {
+                return errorResponse("Unknown index function: " + value);
+            }
+        } else if (key == "policy") {
+            if (!parseReplacementPolicy(value, policy)) {
+                return errorResponse("Unknown replacement policy: " + value);
+            }
+        } else {
+            return errorResponse("Unknown field: " + key);
+        }
+    }
+
+    auto app = traces.find(app_name);
+    if (app == traces.end()) {
+        return errorResponse("Application not loaded: " + app_name);
+    }
+    if (s <= 0 || E <= 0 || b <= 0) {
+        return errorResponse("Missing or invalid required parameters");
+    }
+    if (s > MAX_SET_BITS || b > MAX_BLOCK_BITS || E > MAX_ASSOC ||
+        (1LL << (s + b)) * E > MAX_CACHE_BYTES) {
+        return errorResponse("Cache too large");
+    }
+
+    // The preloaded traces are shared read-only between concurrent queries
+    CacheSimulator simulator(s, E, b, seed, index_fn, policy);
+    for (int i = 0; i < 4; i++) {
+        simulator.feed(i, app->second[i]);
+    }
+    simulator.run();
+
+    std::ostringstream response;
+    response << "{\"status\":\"ok\",\"app\":\"" << jsonEscape(app_name) << "\",\"result\":";
+    simulator.writeResultsJson(response);
+    response << "}";
+    return response.str();
+}
+
+std::string SimulationServer::runQuery(const std::string& request) {
+    auto response = std::make_shared<std::promise<std::string>>();
+    std::future<std::string> result = response->get_future();
+    pool.submit([this, request, response] { response->set_value(handleRequest(request)); });
+    return result.get();
+}
+
+void SimulationServer::handleConnection(int client_fd) {
+    std::string buffer;
+    char chunk[4096];
+
+    while (true) {
+        ssize_t received = recv(client_fd, chunk, sizeof(chunk), 0);
+        if (received <= 0) {
+            break;  // Client closed the connection (or it failed)
+        }
+        buffer.append(chunk, received);
+
+        // Answer every complete line
+        size_t newline;
+        while ((newline = buffer.find('\n')) != std::string::npos) {
+            std::string request = buffer.substr(0, newline);
+            buffer.erase(0, newline + 1);
+            if (!request.empty() && request.back() == '\r') {
+                request.pop_back();
+            }
+            if (request.empty()) {
+                continue;
+            }
+
+            std::string response = runQuery(request) + "\n";
+            size_t sent = 0;
+            while (sent < response.size()) {
+                ssize_t n = send(client_fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+                if (n <= 0) {
+                    close(client_fd);
+                    return;
+                }
+                sent += n;
+            }
+        }
+        
+        if (buffer.size() > MAX_REQUEST_BYTES) {
+            std::string response = errorResponse("Request too long") + "\n";
+            send(client_fd, response.data(), response.size(), MSG_NOSIGNAL);
+            break;
+        }
+    }
+    close(client_fd);
+}
+
+int SimulationServer::serve() {
+    sockaddr_un addr;
+    if (socket_path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Error: Socket path too long: " << socket_path << std::endl;
+        return 1;
+    }
+
+    // Replace a socket left behind by a previous server, but never another
+    // kind of file a mistyped path happens to name
+    struct stat existing;
+    if (lstat(socket_path.c_str(), &existing) == 0) {
+        if (!S_ISSOCK(existing.st_mode)) {
+            std::cerr << "Error: " << socket_path << " exists and is not a socket" << std::endl;
+            return 1;
+        }
+        unlink(socket_path.c_str());
+    }
+
+    int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server_fd < 0) {
+        std::cerr << "Error: Could not create socket: " << strerror(errno) << std::endl;
+        return 1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+    if (bind(server_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        listen(server_fd, 64) < 0) {
+        std::cerr << "Error: Could not listen on " << socket_path << ": " << strerror(errno) << std::endl;
+        close(server_fd);
+        return 1;
+    }
+
+    // A client hanging up mid-response must not kill the server
+    signal(SIGPIPE, SIG_IGN);
+    std::cout << "Serving " << traces.size() << " application(s) on " << socket_path << std::endl;
+
+    while (true) {
+        int client_fd = accept(server_fd, nullptr, nullptr);
+        if (client_fd < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Error: accept failed: " << strerror(errno) << std::endl;
+            close(server_fd);
+            return 1;
+        }
+        // Connections wait on their own thread, only queries take a pool worker
+        std::thread(&SimulationServer::handleConnection, this, client_fd).detach();
+    }
+}
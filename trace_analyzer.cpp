@@ -0,0 +1,296 @@
+#include "cache_simulator.h"
+
+ReuseDistanceTracker::ReuseDistanceTracker() :
+    tree(1024, 0),
+    next_slot(0),
+    cold_accesses(0),
+    total_accesses(0) {}
+
+void ReuseDistanceTracker::treeAdd(int slot, int delta) {
+    for (int i = slot + 1; i <= (int)tree.size(); i += i & -i) {
+        tree[i - 1] += delta;
+    }
+}
+
+int ReuseDistanceTracker::treeSum(int slot) const {
+    int sum = 0;
+    for (int i = slot + 1; i > 0; i -= i & -i) {
+        sum += tree[i - 1];
+    }
+    return sum;
+}
+
+void ReuseDistanceTracker::compact() {
+    // Renumber the live timestamps 0..U-1 keeping their relative order
+    std::vector<std::pair<int, uint32_t>> live;
+    live.reserve(last_use.size());
+    for (auto& entry : last_use) {
+        live.emplace_back(entry.second, entry.first);
+    }
+    std::sort(live.begin(), live.end());
+
+    int capacity = std::max(1024, 2 * (int)live.size());
+    tree.assign(capacity, 0);
+    for (int i = 0; i < (int)live.size(); i++) {
+        last_use[live[i].second] = i;
+        treeAdd(i, 1);
+    }
+    next_slot = live.size();
+}
+
+void ReuseDistanceTracker::access(uint32_t block) {
+    total_accesses++;
+    if (next_slot == (int)tree.size()) {
+        compact();
+    }
+
+    auto it = last_use.find(block);
+    if (it == last_use.end()) {
+        // First touch, infinite reuse distance
+        cold_accesses++;
+        last_use[block] = next_slot;
+    } else {
+        // Distinct blocks touched since the previous use of this block
+        int prev = it->second;
+        int distance = treeSum(next_slot - 1) - treeSum(prev);
+
+        int bucket = 0;
+        while (distance >> bucket) {
+            bucket++;
+        }
+        if (bucket >= (int)histogram.size()) {
+            histogram.resize(bucket + 1, 0);
+        }
+        histogram[bucket]++;
+
+        treeAdd(prev, -1);
+        it->second = next_slot;
+    }
+    treeAdd(next_slot, 1);
+    next_slot++;
+}
+
+TraceAnalyzer::TraceAnalyzer(const std::string& app_name, int b, int window,
+                             const std::string& output_file) :
+    app_name(app_name),
+    output_filename(output_file),
+    b_bits(b),
+    window_size(window),
+    core_reuse(NUM_CORES),
+    core_footprint(NUM_CORES, std::vector<int>(MAX_FOOTPRINT_BITS - MIN_FOOTPRINT_BITS + 1, 0)),
+    global_footprint(MAX_FOOTPRINT_BITS - MIN_FOOTPRINT_BITS + 1, 0) {}
+
+bool TraceAnalyzer::run() {
+    const int num_sizes = MAX_FOOTPRINT_BITS - MIN_FOOTPRINT_BITS + 1;
+
+    // Cores are only used as trace readers here, they have no cache
+    std::vector<std::unique_ptr<Core>> cores;
+    for (int i = 0; i < NUM_CORES; i++) {
+        std::string trace_filename = app_name + "_proc" + std::to_string(i) + ".trace";
+        cores.push_back(std::make_unique<Core>(i, nullptr, trace_filename));
+        if (!cores[i]->isTraceOpen()) {
+            std::cerr << "Error: Could not open trace file: " << trace_filename << std::endl;
+            return false;
+        }
+    }
+
+    std::vector<std::unordered_set<uint32_t>> window_core(NUM_CORES);
+    std::unordered_set<uint32_t> window_global;
+    std::vector<std::vector<std::unordered_set<uint32_t>>> footprint_core(
+        NUM_CORES, std::vector<std::unordered_set<uint32_t>>(num_sizes));
+    std::vector<std::unordered_set<uint32_t>> footprint_global(num_sizes);
+
+    auto closeWindow = [&]() {
+        std::vector<int> row;
+        row.push_back(window_global.size());
+        for (int i = 0; i < NUM_CORES; i++) {
+            row.push_back(window_core[i].size());
+            window_core[i].clear();
+        }
+        window_global.clear();
+        working_sets.push_back(row);
+    };
+
+    // Interleave the cores one access at a time, like the simulator does
+    std::vector<bool> active(NUM_CORES, true);
+    long long global_count = 0;
+    bool any_active = true;
+    while (any_active) {
+        any_active = false;
+        for (int i = 0; i < NUM_CORES; i++) {
+            if (!active[i]) continue;
+
+            MemoryAccess access;
+            if (!cores[i]->readNextAccess(access)) {
+                active[i] = false;
+                continue;
+            }
+            any_active = true;
+            if (access.op != 'R' && access.op != 'r' && access.op != 'W' && access.op != 'w') {
+                continue;  // Skip unknown operations
+            }
+            uint32_t addr = access.addr;
+
+            uint32_t block = addr >> b_bits;
+            core_reuse[i].access(block);
+            global_reuse.access(block);
+
+            window_core[i].insert(block);
+            window_global.insert(block);
+
+            for (int k = 0; k < num_sizes; k++) {
+                uint32_t fp_block = addr >> (MIN_FOOTPRINT_BITS + k);
+                footprint_core[i][k].insert(fp_block);
+                footprint_global[k].insert(fp_block);
+            }
+
+            if (++global_count % window_size == 0) {
+                closeWindow();
+            }
+        }
+    }
+
+    // Account for the trailing partial window
+    if (!window_global.empty()) {
+        closeWindow();
+    }
+
+    for (int k = 0; k < num_sizes; k++) {
+        global_footprint[k] = footprint_global[k].size();
+        for (int i = 0; i < NUM_CORES; i++) {
+            core_footprint[i][k] = footprint_core[i][k].size();
+        }
+    }
+    return true;
+}
+
+void TraceAnalyzer::outputHistogram(std::ostream& out, const std::string& title,
+                                    const ReuseDistanceTracker& tracker) {
+    out << title << "\n";
+    out << std::setw(20) << "Distance"
+        << std::setw(15) << "Count"
+        << std::setw(15) << "Fraction"
+        << std::setw(15) << "Cumulative" << "\n";
+
+    long long total = tracker.getTotalAccesses();
+    long long cumulative = 0;
+    const std::vector<long long>& histogram = tracker.getHistogram();
+    for (int k = 0; k < (int)histogram.size(); k++) {
+        std::string range = (k == 0) ? "0" :
+            "[" + std::to_string(1LL << (k - 1)) + ", " + std::to_string(1LL << k) + ")";
+        cumulative += histogram[k];
+        out << std::setw(20) << range
+            << std::setw(15) << histogram[k]
+            << std::setw(15) << std::fixed << std::setprecision(4)
+            << (total ? (double)histogram[k] / total : 0.0)
+            << std::setw(15) << (total ? (double)cumulative / total : 0.0) << "\n";
+    }
+    out << std::setw(20) << "cold"
+        << std::setw(15) << tracker.getColdAccesses()
+        << std::setw(15) << std::fixed << std::setprecision(4)
+        << (total ? (double)tracker.getColdAccesses() / total : 0.0)
+        << std::setw(15) << "-" << "\n\n";
+}
+
+void TraceAnalyzer::outputResults() {
+    std::ofstream outfile;
+    if (!output_filename.empty()) {
+        outfile.open(output_filename);
+        if (!outfile.is_open()) {
+            std::cerr << "Error: Could not open output file: " << output_filename << std::endl;
+            return;
+        }
+    }
+
+    // Output stream: either file or stdout
+    std::ostream& out = output_filename.empty() ? std::cout : outfile;
+
+    out << "Trace Analysis for " << app_name << "\n";
+    out << "===================================\n";
+    out << "  Block bits (b): " << b_bits << " (Block size: " << (1 << b_bits) << " bytes)\n";
+    out << "  Working-set window: " << window_size << " accesses\n\n";
+
+    out << "Per-core Summary:\n";
+    out << "-----------------\n";
+    out << std::setw(10) << "Core ID"
+        << std::setw(15) << "Accesses"
+        << std::setw(15) << "Unique Blocks"
+        << std::setw(15) << "Cold Accesses" << "\n";
+    for (int i = 0; i < NUM_CORES; i++) {
+        out << std::setw(10) << i
+            << std::setw(15) << core_reuse[i].getTotalAccesses()
+            << std::setw(15) << core_reuse[i].getUniqueBlocks()
+            << std::setw(15) << core_reuse[i].getColdAccesses() << "\n";
+    }
+    out << std::setw(10) << "all"
+        << std::setw(15) << global_reuse.getTotalAccesses()
+        << std::setw(15) << global_reuse.getUniqueBlocks()
+        << std::setw(15) << global_reuse.getColdAccesses() << "\n\n";
+
+    // Cumulative fraction up to [2^(k-1), 2^k) is the hit rate of a fully
+    // associative LRU cache holding 2^k blocks
+    out << "Reuse Distance Histograms (distinct blocks between uses):\n";
+    out << "--------------------------------------------------------\n";
+    outputHistogram(out, "Global (interleaved):", global_reuse);
+    for (int i = 0; i < NUM_CORES; i++) {
+        outputHistogram(out, "Core " + std::to_string(i) + ":", core_reuse[i]);
+    }
+
+    out << "Working Set (distinct blocks per window):\n";
+    out << "-----------------------------------------\n";
+    out << std::setw(10) << "Window" << std::setw(10) << "Global";
+    for (int i = 0; i < NUM_CORES; i++) {
+        out << std::setw(10) << ("Core " + std::to_string(i));
+    }
+    out << "\n";
+    for (int w = 0; w < (int)working_sets.size(); w++) {
+        out << std::setw(10) << w;
+        for (int count : working_sets[w]) {
+            out << std::setw(10) << count;
+        }
+        out << "\n";
+    }
+
+    if (!working_sets.empty()) {
+        const char* labels[] = { "min", "mean", "max" };
+        for (int stat = 0; stat < 3; stat++) {
+            out << std::setw(10) << labels[stat];
+            for (int col = 0; col <= NUM_CORES; col++) {
+                int min_ws = working_sets[0][col], max_ws = working_sets[0][col];
+                double sum = 0;
+                for (auto& row : working_sets) {
+                    min_ws = std::min(min_ws, row[col]);
+                    max_ws = std::max(max_ws, row[col]);
+                    sum += row[col];
+                }
+                if (stat == 1) {
+                    out << std::setw(10) << std::fixed << std::setprecision(1)
+                        << sum / working_sets.size();
+                } else {
+                    out << std::setw(10) << (stat == 0 ? min_ws : max_ws);
+                }
+            }
+            out << "\n";
+        }
+    }
+
+    out << "\nBlock Footprint (distinct blocks touched):\n";
+    out << "------------------------------------------\n";
+    out << std::setw(12) << "Block Size" << std::setw(12) << "Global";
+    for (int i = 0; i < NUM_CORES; i++) {
+        out << std::setw(10) << ("Core " + std::to_string(i));
+    }
+    out << std::setw(15) << "Global Bytes" << "\n";
+    for (int k = 0; k <= MAX_FOOTPRINT_BITS - MIN_FOOTPRINT_BITS; k++) {
+        int block_bytes = 1 << (MIN_FOOTPRINT_BITS + k);
+        out << std::setw(12) << block_bytes << std::setw(12) << global_footprint[k];
+        for (int i = 0; i < NUM_CORES; i++) {
+            out << std::setw(10) << core_footprint[i][k];
+        }
+        out << std::setw(15) << (long long)global_footprint[k] * block_bytes << "\n";
+    }
+
+    if (!output_filename.empty()) {
+        outfile.close();
+    }
+}